@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+
 typedef enum
 {
     D64SM_Event_Listen,
@@ -24,8 +27,12 @@ typedef enum
     D64SM_Event_FileNotFound,
     D64SM_Event_SpecialFilename,
     D64SM_Event_AtnRequest,
+    D64SM_Event_Timeout,
+    D64SM_Event_Count,
 } D64SM_Event_t;
 
 void D64SM_init(void);
-void D64SM_runCycle(void);
-void D64SM_raiseEvent(const D64SM_Event_t ev);
+void D64SM_runCycle(void); /**< Events to completion, then one slice of state work. */
+bool D64SM_isIdle(void); /**< Nothing to do until the next interrupt. */
+void D64SM_raiseEvent(const D64SM_Event_t ev); /**< Main loop only. */
+uint16_t D64SM_getDroppedEvents(void); /**< Events raised while the queue was full, since D64SM_init(). */
@@ -0,0 +1,39 @@
+/*
+ * benchmark_main.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+/* host entry point, reports how fast the drive code interpreter runs; */
+/* built from the repository root with */
+/*   gcc -O2 -std=gnu99 -DWIN32 -Iplatform/iface -Iapplication/iface -o drive_benchmark */
+/*       application/main/host/benchmark_main.c platform/modules/drive/impl/drive.c */
+/*       platform/modules/d64fat/impl/d64*.c platform/modules/iec/impl/iec.c */
+/*       platform/modules/flash/impl/flash.c platform/modules/timeEvent/timeEvent.c */
+
+#ifdef WIN32
+
+#include "driveIface.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* a 1541 runs at 1 MHz, the target needs to keep up with that */
+#define BENCHMARK_DEFAULT_CYCLES (100000000uL)
+#define BENCHMARK_DRIVE_HZ       (1000000uL)
+
+int main(int argc, char* argv[])
+{
+    const uint32_t cycles = (argc > 1) ? (uint32_t) strtoul(argv[1], NULL, 0) : BENCHMARK_DEFAULT_CYCLES;
+    const uint32_t rate = Drive_benchmark(cycles);
+
+    printf("%lu emulated cycles in %.2f s of drive time: %lu cycles/s, %.1fx a 1541\n",
+           (unsigned long) cycles, (double) cycles / BENCHMARK_DRIVE_HZ,
+           (unsigned long) rate, (double) rate / BENCHMARK_DRIVE_HZ);
+
+    return ((0u != rate) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+#endif
@@ -10,10 +10,39 @@
 #include "peripherals.h"
 #include "pin_mux.h"
 
+#include "d64Iface.h"
+#include "d64smIface.h"
+#include "delayIface.h"
+#include "iecIface.h"
+#include "timeEventIface.h"
+
 int main(void)
 {
     BOARD_InitBootClocks();
     BOARD_InitBootPins();
     BOARD_InitBootPeripherals();
 
+    /* once the clocks are final, before anything is timed with a delay */
+    Delay_calibrate();
+
+    /* restores the last image from its snapshot, only a new image is scanned */
+    D64_mount();
+
+    TimeEvent_init();
+    IEC_init();
+    D64SM_init();
+
+    for (;;)
+    {
+        /* everything pending is handled before the core may sleep */
+        D64SM_runCycle();
+
+        /* an interrupt between the check and WFI stays pending and ends the sleep at once */
+        __disable_irq();
+        if (D64SM_isIdle())
+        {
+            __WFI();
+        }
+        __enable_irq();
+    }
 }
@@ -9,197 +9,537 @@
  */
 
 #include "d64smIface.h"
+#include "d64Iface.h"
+#include "iecIface.h"
+#include "driveIface.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
-typedef struct
-{
-    D64SM_Event_t ev;
-    void* targetState;
-} D64SM_Transition_t;
-
-#define MAX_OUTGOING_TRANSITIONS (4)
-
-typedef struct
+/* State ids, index the state and transition tables. None is 0 so that an */
+/* event left out of the transition table does nothing. */
+typedef enum
 {
-    D64SM_Transition_t transitionList[MAX_OUTGOING_TRANSITIONS];
-    uint8_t numTransitions;
-} D64SM_TransitionList_t;
+    D64SM_State_None,
+    D64SM_State_DeviceClosed,
+    D64SM_State_DeviceOpen,
+    D64SM_State_ClosingChannels,
+    D64SM_State_StoreData,
+    D64SM_State_ReadFilename,
+    D64SM_State_DeviceTalker,
+    D64SM_State_SearchFilename,
+    D64SM_State_SendDirectory,
+    D64SM_State_SendData,
+    D64SM_State_Error,
+    D64SM_State_Count,
+} D64SM_StateId_t;
 
 typedef void (*D64SM_StateFcn_t)(void);
 
 typedef struct
 {
-    bool isActive;
     D64SM_StateFcn_t entryFcn;
     D64SM_StateFcn_t exitFcn;
     D64SM_StateFcn_t onCycleFcn;
-    D64SM_TransitionList_t outgoingTr;
 } D64SM_State_t;
 
+/* Ring of events raised and drained by the main loop, nothing else touches */
+/* it. The indices run free and wrap at 256, the size has to be a power of */
+/* two so the slot is a mask away. */
 #define EVENT_BUFFER_SIZE (8)
+#define EVENT_BUFFER_MASK (EVENT_BUFFER_SIZE - 1)
+
+/* Passes of state work and events per D64SM_runCycle(), bounds the time */
+/* spent in one call when the bus keeps sending. */
+#define MAX_PASSES_PER_CYCLE (8)
 
 typedef struct
 {
     D64SM_Event_t ev[EVENT_BUFFER_SIZE];
     uint8_t head;
     uint8_t tail;
-    uint8_t numEvents;
 } D64SM_EventBuffer_t;
 
 typedef struct
 {
-    struct
-    {
-        D64SM_State_t deviceClosed;
-        D64SM_State_t deviceOpen;
-        D64SM_State_t closingChannels;
-        D64SM_State_t storeData;
-        D64SM_State_t readFilename;
-        D64SM_State_t deviceTalker;
-        D64SM_State_t searchFilename;
-        D64SM_State_t sendDirectory;
-        D64SM_State_t sendData;
-        D64SM_State_t error;
-    } state;
-
-    D64SM_State_t* currentState;
+    D64SM_StateId_t currentState;
     D64SM_EventBuffer_t evBuffer;
+    uint16_t droppedEvents; // raised on a full ring, the transition is lost
+
+    D64_NameMatch_t nameMatch;
+    C64_Load_Result_t loadResult;
+    const D64_DirEntry_t* file;
+    D64_FileWriter_t writer;
+    D64_Transfer_t transfer;
+    uint8_t channel;
+    bool isNameNew;   // an OPEN name that no SAVE has used yet
+    bool isStoreDone; // the data in StoreData ended with EOI
 } D64SM_t;
 
 static D64SM_t self;
 
 /* Local prototypes. */
 static void processEvent(const D64SM_Event_t ev);
-static void initState(D64SM_State_t* const state, D64SM_StateFcn_t const entry, D64SM_StateFcn_t const exit, D64SM_StateFcn_t const onCycle);
-static void addTransition(D64SM_State_t* const state, const D64SM_Event_t ev, const D64SM_State_t* const targetState);
 static void initEventBuffer(D64SM_EventBuffer_t* const buffer);
 static bool addEvent(D64SM_EventBuffer_t* const buffer, const D64SM_Event_t ev);
 static bool popEvent(D64SM_EventBuffer_t* const buffer, D64SM_Event_t* const ev);
+static bool isEventPending(const D64SM_EventBuffer_t* const buffer);
+static void pollBus(void);
+static bool isSendReady(void);
+
+/* State functions. */
+static void readFilenameEntry(void);
+static void readFilenameOnCycle(void);
+static void readFilenameExit(void);
+static void searchFilenameEntry(void);
+static void deviceClosedEntry(void);
+static void closingChannelsEntry(void);
+static void storeDataEntry(void);
+static void storeDataOnCycle(void);
+static void storeDataExit(void);
+static void sendDirectoryEntry(void);
+static void sendDataEntry(void);
+static void sendOnCycle(void);
+static void sendExit(void);
+static void errorEntry(void);
+
+/* Entry, exit and on cycle functions of every state. */
+static const D64SM_State_t states[D64SM_State_Count] = {
+    [D64SM_State_DeviceClosed]    = { deviceClosedEntry, NULL, NULL },
+    [D64SM_State_DeviceOpen]      = { NULL, NULL, NULL },
+    [D64SM_State_ClosingChannels] = { closingChannelsEntry, NULL, NULL },
+    [D64SM_State_StoreData]       = { storeDataEntry, storeDataExit, storeDataOnCycle },
+    [D64SM_State_ReadFilename]    = { readFilenameEntry, readFilenameExit, readFilenameOnCycle },
+    [D64SM_State_DeviceTalker]    = { NULL, NULL, NULL },
+    [D64SM_State_SearchFilename]  = { searchFilenameEntry, NULL, NULL },
+    [D64SM_State_SendDirectory]   = { sendDirectoryEntry, sendExit, sendOnCycle },
+    [D64SM_State_SendData]        = { sendDataEntry, sendExit, sendOnCycle },
+    [D64SM_State_Error]           = { errorEntry, NULL, NULL },
+};
+
+/* Target state for every state and event, D64SM_State_None (left out) is no transition. */
+static const uint8_t transitions[D64SM_State_Count][D64SM_Event_Count] = {
+    [D64SM_State_DeviceClosed] = {
+        [D64SM_Event_Listen]          = D64SM_State_DeviceOpen,
+        [D64SM_Event_Talk]            = D64SM_State_DeviceTalker,
+    },
+    [D64SM_State_DeviceOpen] = {
+        [D64SM_Event_Close]           = D64SM_State_ClosingChannels,
+        [D64SM_Event_OpenDat]         = D64SM_State_StoreData,
+        [D64SM_Event_Open]            = D64SM_State_ReadFilename,
+        [D64SM_Event_Unlisten]        = D64SM_State_DeviceClosed,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+    [D64SM_State_ClosingChannels] = {
+        [D64SM_Event_Unlisten]        = D64SM_State_DeviceClosed,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+    [D64SM_State_StoreData] = {
+        [D64SM_Event_EOI]             = D64SM_State_DeviceOpen,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+    [D64SM_State_ReadFilename] = {
+        [D64SM_Event_EOI]             = D64SM_State_DeviceOpen,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+    [D64SM_State_DeviceTalker] = {
+        [D64SM_Event_OpenDat]         = D64SM_State_SearchFilename,
+        [D64SM_Event_Untalk]          = D64SM_State_DeviceClosed,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+    [D64SM_State_SearchFilename] = {
+        [D64SM_Event_FileFound]       = D64SM_State_SendData,
+        [D64SM_Event_SpecialFilename] = D64SM_State_SendDirectory,
+        [D64SM_Event_FileNotFound]    = D64SM_State_Error,
+    },
+    [D64SM_State_SendDirectory] = {
+        [D64SM_Event_EOI]             = D64SM_State_DeviceTalker,
+        [D64SM_Event_AtnRequest]      = D64SM_State_DeviceClosed,
+        [D64SM_Event_Untalk]          = D64SM_State_DeviceClosed,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+    [D64SM_State_SendData] = {
+        [D64SM_Event_EOI]             = D64SM_State_DeviceTalker,
+        [D64SM_Event_FileNotFound]    = D64SM_State_Error,
+        [D64SM_Event_AtnRequest]      = D64SM_State_DeviceClosed,
+        [D64SM_Event_Untalk]          = D64SM_State_DeviceClosed,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+    [D64SM_State_Error] = {
+        [D64SM_Event_Untalk]          = D64SM_State_DeviceClosed,
+        [D64SM_Event_Timeout]         = D64SM_State_DeviceClosed,
+    },
+};
 
 void D64SM_init(void)
 {
-    initState(&self.state.deviceClosed, NULL, NULL, NULL);
     initEventBuffer(&self.evBuffer);
+    self.droppedEvents = 0;
+
+    self.currentState = D64SM_State_DeviceClosed;
+    self.loadResult = C64_Load_Result_FileNotFound;
+    self.file = NULL;
+    self.writer.isOpen = false;
+    self.transfer.isOpen = false;
+    self.channel = 0;
+    self.isNameNew = false;
+    self.isStoreDone = false;
+}
 
-    addTransition(&self.state.deviceClosed, D64SM_Event_Listen, (void*) &self.state.deviceOpen);
-    addTransition(&self.state.deviceClosed, D64SM_Event_Talk, (void*) &self.state.deviceTalker);
+void D64SM_raiseEvent(const D64SM_Event_t ev)
+{
+    if (!addEvent(&self.evBuffer, ev))
+    {
+        self.droppedEvents++;
+    }
+}
 
-    addTransition(&self.state.deviceOpen, D64SM_Event_Close, (void*) &self.state.closingChannels);
-    addTransition(&self.state.deviceOpen, D64SM_Event_OpenDat, (void*) &self.state.storeData);
-    addTransition(&self.state.deviceOpen, D64SM_Event_Open, (void*) &self.state.readFilename);
-    addTransition(&self.state.deviceOpen, D64SM_Event_Unlisten, (void*) &self.state.deviceClosed);
+uint16_t D64SM_getDroppedEvents(void)
+{
+    return (self.droppedEvents);
+}
+
+void D64SM_runCycle(void)
+{
+    /* Uploaded drive code has the bus until it returns to dos or stops polling it. */
+    if (Drive_isRunning())
+    {
+        (void) Drive_run(DRIVE_SLICE_CYCLES);
+        return;
+    }
 
-    addTransition(&self.state.storeData, D64SM_Event_EOI, (void*) &self.state.deviceOpen);
+    /* Pending SAVE data goes to flash once the bus has been quiet for a while. */
+    D64_Cache_poll();
 
-    addTransition(&self.state.readFilename, D64SM_Event_EOI, (void*) &self.state.deviceOpen);
+    /* Run to completion, a burst of commands and data is taken in one call. */
+    for (uint8_t pass = 0; pass < MAX_PASSES_PER_CYCLE; pass++)
+    {
+        if (states[self.currentState].onCycleFcn)
+        {
+            states[self.currentState].onCycleFcn();
+        }
 
-    addTransition(&self.state.deviceTalker, D64SM_Event_OpenDat, (void*) &self.state.searchFilename);
-    addTransition(&self.state.deviceTalker, D64SM_Event_Untalk, (void*) &self.state.deviceClosed);
+        /* Commands are picked up after the state has taken the data in front of them. */
+        pollBus();
 
-    addTransition(&self.state.searchFilename, D64SM_Event_FileFound, (void*) &self.state.sendData);
-    addTransition(&self.state.searchFilename, D64SM_Event_SpecialFilename, (void*) &self.state.sendDirectory);
-    addTransition(&self.state.searchFilename, D64SM_Event_FileNotFound, (void*) &self.state.error);
+        bool isProcessed = false;
+        D64SM_Event_t ev;
+        while (popEvent(&self.evBuffer, &ev))
+        {
+            processEvent(ev);
+            isProcessed = true;
+        }
 
-    addTransition(&self.state.sendData, D64SM_Event_EOI, (void*) &self.state.deviceTalker);
-    addTransition(&self.state.sendData, D64SM_Event_AtnRequest, (void*) &self.state.deviceClosed);
+        if (!isProcessed)
+        {
+            break;
+        }
+    }
+}
 
-    addTransition(&self.state.sendDirectory, D64SM_Event_EOI, (void*) &self.state.deviceTalker);
-    addTransition(&self.state.sendDirectory, D64SM_Event_AtnRequest, (void*) &self.state.deviceClosed);
+bool D64SM_isIdle(void)
+{
+    /* Anything new comes with an interrupt, the ms tick included. */
+    return ((!isEventPending(&self.evBuffer)) && (!IEC_hasPending()) && (!Drive_isRunning()) && (!isSendReady()));
 }
 
-void D64SM_raiseEvent(const D64SM_Event_t ev)
+static void processEvent(const D64SM_Event_t ev)
 {
-    if (!addEvent(&self.evBuffer, ev))
+    if (ev >= D64SM_Event_Count)
+    {
+        return;
+    }
+
+    const D64SM_StateId_t target = (D64SM_StateId_t) transitions[self.currentState][ev];
+    if (D64SM_State_None == target)
+    {
+        return;
+    }
+
+    if (states[self.currentState].exitFcn)
+    {
+        states[self.currentState].exitFcn();
+    }
+    self.currentState = target;
+    if (states[self.currentState].entryFcn)
     {
-        /* Error! */
+        states[self.currentState].entryFcn();
     }
 }
 
-void D64SM_runCycle(void)
+static void initEventBuffer(D64SM_EventBuffer_t* const buffer)
 {
-    if (self.currentState->onCycleFcn)
+    for (uint8_t i = 0; i < EVENT_BUFFER_SIZE; i++)
     {
-        self.currentState->onCycleFcn();
+        buffer->ev[i] = 0;
     }
+    buffer->head = 0;
+    buffer->tail = 0;
+}
 
-    D64SM_Event_t ev;
-    bool result = popEvent(&self.evBuffer, &ev);
+static bool addEvent(D64SM_EventBuffer_t* const buffer, const D64SM_Event_t ev)
+{
+    const uint8_t head = buffer->head;
 
-    if (result)
+    if ((uint8_t) (head - buffer->tail) >= EVENT_BUFFER_SIZE)
     {
-        processEvent(ev);
+        return (false);
     }
+
+    buffer->ev[head & EVENT_BUFFER_MASK] = ev;
+    buffer->head = head + 1;
+
+    return (true);
 }
 
-static void processEvent(const D64SM_Event_t ev)
+static bool popEvent(D64SM_EventBuffer_t* const buffer, D64SM_Event_t* const ev)
+{
+    const uint8_t tail = buffer->tail;
+
+    if (tail == buffer->head)
+    {
+        return (false);
+    }
+
+    *ev = buffer->ev[tail & EVENT_BUFFER_MASK];
+    buffer->tail = tail + 1;
+
+    return (true);
+}
+
+static bool isEventPending(const D64SM_EventBuffer_t* const buffer)
+{
+    return (buffer->tail != buffer->head);
+}
+
+static void pollBus(void)
+{
+    if (IEC_getTimeout())
+    {
+        D64SM_raiseEvent(D64SM_Event_Timeout);
+    }
+
+    uint8_t command;
+    if (!IEC_getCommand(&command))
+    {
+        return;
+    }
+
+    /* The bus interrupts only queue commands for this device. */
+    if (IEC_Command_Unlisten == command)
+    {
+        D64SM_raiseEvent(D64SM_Event_Unlisten);
+    }
+    else if (IEC_Command_Untalk == command)
+    {
+        D64SM_raiseEvent(D64SM_Event_Untalk);
+    }
+    else if (IEC_Command_Listen == (command & 0xe0))
+    {
+        D64SM_raiseEvent(D64SM_Event_Listen);
+    }
+    else if (IEC_Command_Talk == (command & 0xe0))
+    {
+        D64SM_raiseEvent(D64SM_Event_Talk);
+    }
+    else
+    {
+        self.channel = command & 0x0f;
+
+        switch (command & 0xf0)
+        {
+            case IEC_Command_OpenDat:
+                D64SM_raiseEvent(D64SM_Event_OpenDat);
+                break;
+
+            case IEC_Command_Close:
+                D64SM_raiseEvent(D64SM_Event_Close);
+                break;
+
+            case IEC_Command_Open:
+                D64SM_raiseEvent(D64SM_Event_Open);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+static void readFilenameEntry(void)
 {
-    for (uint8_t i = 0; i < self.currentState->outgoingTr.numTransitions; i++)
+    D64_NameMatch_begin(&self.nameMatch);
+}
+
+static void readFilenameOnCycle(void)
+{
+    /* Narrow the lookup with every byte as it arrives on the bus. */
+    uint8_t byte;
+    bool isEOI;
+    while (IEC_getByte(&byte, &isEOI))
     {
-        if (ev == self.currentState->outgoingTr.transitionList[i].ev)
+        D64_NameMatch_feed(&self.nameMatch, byte);
+        if (isEOI)
         {
-            if (self.currentState->outgoingTr.transitionList[i].targetState)
-            {
-                self.currentState->exitFcn();
-                self.currentState = self.currentState->outgoingTr.transitionList[i].targetState;
-                self.currentState->entryFcn();
-            }
+            D64SM_raiseEvent(D64SM_Event_EOI);
         }
     }
 }
 
-static void initState(D64SM_State_t* const state, D64SM_StateFcn_t const entry, D64SM_StateFcn_t const exit, D64SM_StateFcn_t const onCycle)
+static void readFilenameExit(void)
 {
-    state->entryFcn = entry;
-    state->exitFcn = exit;
-    state->onCycleFcn = onCycle;
-    state->isActive = false;
+    /* Resolve now, the lookup is off the path between TALK and the first data byte. */
+    readFilenameOnCycle();
+    self.loadResult = D64_NameMatch_end(&self.nameMatch, &self.file);
+    self.isNameNew = (D64_COMMAND_CHANNEL != self.channel);
 }
 
-static void addTransition(D64SM_State_t* const state, const D64SM_Event_t ev, const D64SM_State_t* const targetState)
+static void searchFilenameEntry(void)
 {
-    if (state->outgoingTr.numTransitions < MAX_OUTGOING_TRANSITIONS)
+    switch (self.loadResult)
     {
-        D64SM_Transition_t* const tr = &state->outgoingTr.transitionList[state->outgoingTr.numTransitions];
-        tr->ev = ev;
-        tr->targetState = (void*) targetState;
+        case C64_Load_Result_LoadingReady:
+            D64SM_raiseEvent(D64SM_Event_FileFound);
+            break;
 
-        state->outgoingTr.numTransitions++;
+        case C64_Load_Result_DirectoryReady:
+            D64SM_raiseEvent(D64SM_Event_SpecialFilename);
+            break;
+
+        default:
+            D64SM_raiseEvent(D64SM_Event_FileNotFound);
+            break;
     }
 }
 
-static void initEventBuffer(D64SM_EventBuffer_t* const buffer)
+static void deviceClosedEntry(void)
 {
-    for (uint8_t i = 0; i < EVENT_BUFFER_SIZE; i++)
+    /* UNLISTEN, nothing more is coming for now. */
+    D64_Cache_flush();
+}
+
+static void closingChannelsEntry(void)
+{
+    if (self.writer.isOpen)
     {
-        buffer->ev[i] = 0;
+        (void) D64_FileWriter_close(&self.writer);
     }
-    buffer->head = 0;
-    buffer->tail = 0;
-    buffer->numEvents = 0;
+    D64_Cache_flush();
 }
 
-static bool addEvent(D64SM_EventBuffer_t* const buffer, const D64SM_Event_t ev)
+static void storeDataEntry(void)
 {
-    if (buffer->numEvents < EVENT_BUFFER_SIZE)
+    self.isStoreDone = false;
+
+    if (D64_COMMAND_CHANNEL == self.channel)
     {
-        buffer->ev[buffer->head] = ev;
-        buffer->head = (buffer->head + 1) % EVENT_BUFFER_SIZE;
-        return (true);
+        D64_Command_begin();
+        return;
     }
 
-    return (false);
+    /* Every OPEN starts a file of its own, one still open never got its CLOSE. */
+    /* Without a new name the data goes on into the open file, PRINT# spans LISTENs. */
+    if (self.isNameNew)
+    {
+        self.isNameNew = false;
+        D64_FileWriter_abandon(&self.writer);
+        (void) D64_FileWriter_open(&self.writer, self.nameMatch.name, self.nameMatch.length, D64_DIR_TYPE_CLOSED_PRG);
+    }
 }
 
-static bool popEvent(D64SM_EventBuffer_t* const buffer, D64SM_Event_t* const ev)
+static void storeDataOnCycle(void)
+{
+    uint8_t byte;
+    bool isEOI;
+    while (IEC_getByte(&byte, &isEOI))
+    {
+        if (D64_COMMAND_CHANNEL == self.channel)
+        {
+            /* Drive commands, M-W/M-E of a fastloader is looked up when complete. */
+            D64_Command_feed(byte);
+            if (isEOI)
+            {
+                D64_Command_end();
+            }
+        }
+        else
+        {
+            (void) D64_FileWriter_write(&self.writer, byte);
+        }
+
+        if (isEOI)
+        {
+            self.isStoreDone = true;
+            D64SM_raiseEvent(D64SM_Event_EOI);
+        }
+    }
+}
+
+static void storeDataExit(void)
+{
+    /* Only a timeout leaves before EOI, the host went away in the middle of the data. */
+    if ((!self.isStoreDone) && (D64_COMMAND_CHANNEL != self.channel))
+    {
+        D64_FileWriter_abandon(&self.writer);
+    }
+}
+
+static void sendDirectoryEntry(void)
+{
+    D64_Transfer_beginDirectory(&self.transfer);
+}
+
+static void sendDataEntry(void)
+{
+    /* A chain that breaks later shows up as an abort on a slice. */
+    if (!D64_Transfer_beginProgram(&self.transfer, self.file->track, self.file->sector))
+    {
+        D64SM_raiseEvent(D64SM_Event_FileNotFound);
+    }
+}
+
+static void sendOnCycle(void)
+{
+    /* One listing line or sector per call, ATN is seen between slices. */
+    switch (D64_Transfer_step(&self.transfer))
+    {
+        case D64_Transfer_Result_Done:
+            D64SM_raiseEvent(D64SM_Event_EOI);
+            break;
+
+        case D64_Transfer_Result_Aborted:
+            D64SM_raiseEvent(D64SM_Event_AtnRequest);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void sendExit(void)
 {
-    if (buffer->numEvents > 0)
+    D64_Transfer_end(&self.transfer);
+}
+
+static void errorEntry(void)
+{
+    /* Nothing to send, the host gets an empty talk instead of a held CLK. */
+    IEC_endTalk();
+}
+
+static bool isSendReady(void)
+{
+    if ((D64SM_State_SendData != self.currentState) && (D64SM_State_SendDirectory != self.currentState))
+    {
+        return (false);
+    }
+
+    /* The interrupt that ended the slice or turned the bus around may have */
+    /* come after sendOnCycle() looked, it raises nothing to wake up on. */
+    if (self.transfer.isSending)
     {
-        *ev = buffer->ev[buffer->tail];
-        buffer->tail = (buffer->tail + 1) % EVENT_BUFFER_SIZE;
-        return (true);
+        return (IEC_Result_Busy != IEC_getBlockResult());
     }
 
-    return (false);
+    return (IEC_isTalking());
 }
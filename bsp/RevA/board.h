@@ -14,6 +14,30 @@
 #define BOARD_SENSORPULSE_PIN  (6u + PTD_OFFSET)
 /** @} */
 
+/** @name Commodore serial bus (IEC).
+ *  Inputs read the bus lines directly, a high level is a released line.
+ *  Outputs drive open collector inverters, a high level pulls the line.
+ *  ATN and CLK are on KBI0 (PTA0-PTD7 map to KBI0 P0-P31 in pin order),
+ *  ATN on the lower pin so it is served first.
+ *  @{ */
+#define BOARD_IEC_GPIO         (PTD)
+#define BOARD_IEC_KBI          (KBI0)
+#define BOARD_IEC_KBI_IRQ      (KBI0_IRQn)
+#define BOARD_IEC_ATN_IN_PIN   (0u + PTD_OFFSET)
+#define BOARD_IEC_CLK_IN_PIN   (1u + PTD_OFFSET)
+#define BOARD_IEC_DATA_IN_PIN  (2u + PTD_OFFSET)
+#define BOARD_IEC_CLK_OUT_PIN  (3u + PTD_OFFSET)
+#define BOARD_IEC_DATA_OUT_PIN (4u + PTD_OFFSET)
+
+/* same port through the single cycle IOPORT alias, for the bus handlers */
+#define BOARD_IEC_FGPIO         (FGPIOA)
+#define BOARD_IEC_ATN_IN_MASK   (1uL << BOARD_IEC_ATN_IN_PIN)
+#define BOARD_IEC_CLK_IN_MASK   (1uL << BOARD_IEC_CLK_IN_PIN)
+#define BOARD_IEC_DATA_IN_MASK  (1uL << BOARD_IEC_DATA_IN_PIN)
+#define BOARD_IEC_CLK_OUT_MASK  (1uL << BOARD_IEC_CLK_OUT_PIN)
+#define BOARD_IEC_DATA_OUT_MASK (1uL << BOARD_IEC_DATA_OUT_PIN)
+/** @} */
+
 /** @name Motor mosfet driver chip.
  *  @{ */
 #define BOARD_MOTOR_SPI_BASE   (SPI1)
@@ -158,6 +158,10 @@ void KBI0_IRQHandler(void)
 {
     uint32_t mask = KBI0->SP;
 
+    /* Clear before the callbacks, an edge while they run flags again instead of being lost. */
+    KBI0->SC |= KBI_SC_KBACK_MASK;
+    KBI0->SC |= KBI_SC_RSTKBSP_MASK;
+
     /* Which pin? */
     for (uint8_t pin = 0; pin < KBI_NUM_PINS; pin++)
     {
@@ -171,16 +175,16 @@ void KBI0_IRQHandler(void)
         }
         mask = (mask >> 1u);
     }
-
-    /* Clear register. */
-    KBI0->SC |= KBI_SC_KBACK_MASK;
-    KBI0->SC |= KBI_SC_RSTKBSP_MASK;
 }
 
 void KBI1_IRQHandler(void)
 {
     uint32_t mask = KBI1->SP;
 
+    /* Clear before the callbacks, an edge while they run flags again instead of being lost. */
+    KBI1->SC |= KBI_SC_KBACK_MASK;
+    KBI1->SC |= KBI_SC_RSTKBSP_MASK;
+
     /* Which pin? */
     for (uint8_t pin = 0; pin < KBI_NUM_PINS; pin++)
     {
@@ -194,8 +198,4 @@ void KBI1_IRQHandler(void)
         }
         mask = (mask >> 1u);
     }
-
-    /* Clear register. */
-    KBI1->SC |= KBI_SC_KBACK_MASK;
-    KBI1->SC |= KBI_SC_RSTKBSP_MASK;
 }
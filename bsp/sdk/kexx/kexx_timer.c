@@ -133,6 +133,42 @@ void PeriodicTimer_enableInterrupt(const PeriodicTimer_t* const timer, const uin
     }
 }
 
+/* Converts a time into a timer load value. */
+uint32_t PeriodicTimer_getTicks(const uint32_t us)
+{
+    if (0 == us)
+    {
+        return (0); /* sanity check */
+    }
+
+    return (((SystemCoreClock / 2000000) * us) - 1u);
+}
+
+/* Restarts the timer with a new load value and interrupt on timeout. */
+void PeriodicTimer_restart(const PeriodicTimer_t* const timer, const uint32_t ticks)
+{
+    /* a new load value is only taken when the timer is started */
+    PIT->CHANNEL[timer->channel].TCTRL &= ~PIT_TCTRL_TEN_MASK;
+    PIT->CHANNEL[timer->channel].TFLG = PIT_TFLG_TIF_MASK;
+    PIT->CHANNEL[timer->channel].LDVAL = ticks;
+    PIT->CHANNEL[timer->channel].TCTRL |= (PIT_TCTRL_TIE_MASK | PIT_TCTRL_TEN_MASK);
+}
+
+/* Starts the timer free running, without interrupt. */
+void PeriodicTimer_start(const PeriodicTimer_t* const timer, const uint32_t ticks)
+{
+    PIT->CHANNEL[timer->channel].TCTRL &= ~(PIT_TCTRL_TIE_MASK | PIT_TCTRL_TEN_MASK);
+    PIT->CHANNEL[timer->channel].TFLG = PIT_TFLG_TIF_MASK;
+    PIT->CHANNEL[timer->channel].LDVAL = ticks;
+    PIT->CHANNEL[timer->channel].TCTRL |= PIT_TCTRL_TEN_MASK;
+}
+
+/* Reads the current counter value. */
+uint32_t PeriodicTimer_getCount(const PeriodicTimer_t* const timer)
+{
+    return (PIT->CHANNEL[timer->channel].CVAL);
+}
+
 /* Disables timer interrupt on timeout. */
 void PeriodicTimer_disableInterrupt(const PeriodicTimer_t* const timer)
 {
@@ -81,6 +81,45 @@ void PeriodicTimer_clearFlag(const PeriodicTimer_t* const timer);
  ******************************************************************************/
 void PeriodicTimer_enableInterrupt(const PeriodicTimer_t* const timer, const uint32_t us);
 
+/***************************************************************************//**
+ * @brief Converts a time into a timer load value.
+ *
+ * Done once up front, the division is slow on a core without a divider.
+ *
+ * @param us Time in microseconds.
+ * @return Load value for PeriodicTimer_restart().
+ ******************************************************************************/
+uint32_t PeriodicTimer_getTicks(const uint32_t us);
+
+/***************************************************************************//**
+ * @brief Restarts the timer with a new load value and interrupt on timeout.
+ *
+ * The callback and NVIC setup from PeriodicTimer_enableInterrupt() are kept,
+ * so this is cheap enough to be called from the timer's own interrupt.
+ *
+ * @param timer Description of the timer.
+ * @param ticks Load value from PeriodicTimer_getTicks().
+ ******************************************************************************/
+void PeriodicTimer_restart(const PeriodicTimer_t* const timer, const uint32_t ticks);
+
+/***************************************************************************//**
+ * @brief Starts the timer free running, without interrupt.
+ *
+ * @param timer Description of the timer.
+ * @param ticks Load value, the counter reloads with it on timeout.
+ ******************************************************************************/
+void PeriodicTimer_start(const PeriodicTimer_t* const timer, const uint32_t ticks);
+
+/***************************************************************************//**
+ * @brief Reads the current counter value.
+ *
+ * The counter runs down from the load value at half the core clock.
+ *
+ * @param timer Description of the timer.
+ * @return Current timer value.
+ ******************************************************************************/
+uint32_t PeriodicTimer_getCount(const PeriodicTimer_t* const timer);
+
 /***************************************************************************//**
  * @brief Disables timer interrupt on timeout.
  *
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
 
 #define D64_FIELD_SIZE_DIR_TRACK ( 18)
 #define D64_FIELD_SIZE_BAM_TRACK ( 18)
@@ -16,8 +18,65 @@
 #define D64_FIELD_SIZE_NAME      ( 16)
 #define D64_FIELD_SIZE_BLOCK     (254)
 
-uint8_t D64_getSectorLength(const uint8_t track);
-uint32_t D64_getSectorOffset(const uint8_t track);
+#define D64_BAM_SECTOR              ( 0)
+#define D64_BAM_OFFSET_DOS          ( 2)
+#define D64_BAM_OFFSET_ENTRIES      ( 4) // 4 bytes per track: free count + 3 bytes bitmap
+#define D64_BAM_ENTRY_SIZE          ( 4)
+#define D64_BAM_NUM_TRACKS         (35)
+#define D64_BAM_INTERLEAVE         (10) // 1541 default for file data
+#define D64_BAM_DIR_INTERLEAVE      (3) // 1541 default for directory sectors
+
+#define D64_DIR_FIRST_SECTOR        ( 1)
+#define D64_DIR_ENTRIES_PER_SECTOR  ( 8)
+#define D64_DIR_OFFSET_NEXT_TRACK   ( 0)
+#define D64_DIR_OFFSET_NEXT_SECTOR  ( 1)
+#define D64_DIR_OFFSET_TYPE         ( 2)
+#define D64_DIR_OFFSET_TRACK        ( 3)
+#define D64_DIR_OFFSET_SECTOR       ( 4)
+#define D64_DIR_OFFSET_NAME         ( 5)
+#define D64_DIR_OFFSET_BLOCKS       (30)
+
+#define D64_DIR_TYPE_CLOSED_PRG   (0x82)
+#define D64_DIR_TYPE_CLOSED_SEQ   (0x81)
+
+#define D64_DIR_MAX_ENTRIES        (144) // 18 directory sectors, 8 entries each
+#define D64_NAME_PADDING          (0xa0) // c64 shifted space
+
+typedef enum
+{
+    D64_Format_D64, // 35, 40 or 42 tracks
+    D64_Format_D71, // double sided, read only
+    D64_Format_D81, // 80 tracks of 40 sectors, read only
+} D64_Format_t;
+
+/* image layout, picked at mount from the image size */
+typedef struct {
+    const uint8_t*  numSectors; // per track, index 0 is track 1
+    const uint32_t* offsets;    // first byte of each track
+    uint8_t numTracks;
+    uint8_t dirTrack;      // holds the header, BAM and directory
+    uint8_t headerSector;
+    uint8_t dirSector;     // first directory sector
+    uint8_t nameOffset;    // disk name, id and dos type in the header sector
+    uint8_t idOffset;
+    uint8_t dosTypeOffset;
+    bool    isWritable;    // BAM layout known to the allocator
+    D64_Format_t format;
+} D64_Geometry_t;
+
+bool D64_selectGeometry(const uint32_t imageSize); // false if the size is unknown, 35 tracks are assumed
+const D64_Geometry_t* D64_getGeometry(void);
+uint8_t D64_getNumSectors(const uint8_t track); // 1-based track, 0 if not on the image
+bool D64_getSectorAddress(const uint8_t track, const uint8_t sector, uint32_t* const offset); // byte offset in the image
+bool D64_readSector(const uint8_t track, const uint8_t sector, uint8_t* const buf); // 1-based track, pulls a whole sector
+bool D64_writeSector(const uint8_t track, const uint8_t sector, const uint8_t* const buf); // goes through the write cache
+
+void D64_Cache_recover(void); // finish a commit cut short by a power loss, before anything else is read
+bool D64_Cache_readSector(const uint32_t offset, uint8_t* const buf);
+void D64_Cache_writeSector(const uint32_t offset, const uint8_t* const buf, const bool isHeld); // held sectors stay in ram until the flush, others are staged
+void D64_Cache_flush(void); // commit everything, each erase block rewritten through a journaled scratch block
+void D64_Cache_poll(void); // commits the staged block once the bus has been idle for a while
+bool D64_Cache_isDirty(void);
 
 typedef struct{
     uint8_t DiskDOS;
@@ -26,17 +85,90 @@ typedef struct{
     uint8_t DOSType[2];
 } s64Data;
 
+/* compact directory index entry, built once at mount */
 typedef struct {
-    uint8_t  nextDirTrack;
-    uint8_t  nextDirSect;
-    uint8_t  fType[4];
-    uint8_t  fName[17];
-    uint8_t  fTrack;
-    uint8_t  fSect;
-    uint8_t  fBlocksL;
-    uint8_t  fBlocksH;
-    uint16_t fBlocks;
-} dirEntry;
+    uint8_t  name[D64_FIELD_SIZE_NAME]; // padded with D64_NAME_PADDING, as on disk
+    uint16_t hash;
+    uint16_t blocks;
+    uint8_t  type;
+    uint8_t  track;
+    uint8_t  sector;
+} D64_DirEntry_t;
+
+/* cbm filename pattern, compiled once from the OPEN name */
+typedef enum
+{
+    D64_Pattern_Kind_Literal,  // exact name, single hash probe
+    D64_Pattern_Kind_First,    // "*", first file in the directory
+    D64_Pattern_Kind_Wildcard, // literals with '?' and/or a trailing '*'
+} D64_Pattern_Kind_t;
+
+typedef struct {
+    uint8_t  literal[D64_FIELD_SIZE_NAME]; // padded, don't care at '?' positions
+    uint16_t anyMask;     // bit n set: position n is a '?'
+    uint8_t  length;      // number of positions to compare
+    D64_Pattern_Kind_t kind;
+} D64_Pattern_t;
+
+/* filename lookup that narrows its candidates while the OPEN name arrives */
+typedef struct {
+    uint8_t name[D64_FIELD_SIZE_NAME + 2]; // raw name, room for a drive prefix
+    uint8_t length;
+    uint8_t position; // position within the name proper
+    uint8_t lo;       // candidates in name order, [lo, hi)
+    uint8_t hi;
+    bool    isNarrowing; // false once a wildcard is seen
+    bool    isDone;      // options reached, rest is ignored
+} D64_NameMatch_t;
+
+/* sequential reader over a file's track/sector chain, the next linked */
+/* sector is prefetched into the second buffer while the first is consumed */
+typedef struct {
+    uint8_t  buffer[2][D64_FIELD_SIZE_SECTOR];
+    uint8_t  current;    // buffer being consumed
+    uint16_t position;   // next byte in current buffer
+    uint16_t length;     // end of valid data in current buffer
+    uint16_t numBlocks;  // blocks read so far, guards against looped chains
+    bool     isOpen;
+    bool     isPrefetched;
+    bool     prefetchFailed;
+} D64_File_t;
+
+/* sequential writer for SAVE, blocks are allocated and linked as data arrives */
+/* and the directory entry is written on close */
+typedef struct {
+    uint8_t  buffer[D64_FIELD_SIZE_SECTOR];
+    uint8_t  name[D64_FIELD_SIZE_NAME]; // padded
+    uint8_t  type;
+    uint8_t  track;      // block being filled
+    uint8_t  sector;
+    uint8_t  firstTrack;
+    uint8_t  firstSector;
+    uint16_t position;   // next free byte in buffer
+    uint16_t numBlocks;
+    bool     isOpen;
+    bool     isFull;     // ran out of blocks, the file is dropped on close
+} D64_FileWriter_t;
+
+/* a LOAD on the bus, advanced one slice per call from the main loop so that */
+/* ATN and other work get in between; the position is kept here */
+typedef struct {
+    D64_File_t     file;        // program, sector chain being sent
+    const uint8_t* data;        // directory, next listing byte
+    size_t         remaining;   // directory, bytes not sent yet
+    bool           isDirectory;
+    bool           isOpen;
+    bool           isStarted;   // a slice went out, the talker is ours
+    bool           isSending;   // a slice is on the bus
+    bool           isLast;      // the slice on the bus ends the transfer
+} D64_Transfer_t;
+
+typedef enum
+{
+    D64_Transfer_Result_Busy,
+    D64_Transfer_Result_Done,
+    D64_Transfer_Result_Aborted, // ATN, no listener or a broken chain
+} D64_Transfer_Result_t;
 
 typedef enum
 {
@@ -45,7 +177,70 @@ typedef enum
     C64_Load_Result_FileNotFound,
 } C64_Load_Result_t;
 
+void D64_mount(void); // read disk info and build the directory index, or restore them from the snapshot
 void D64_initBAM(void); // needed for write operations etc. (?)
-void D64_printDirectory(void); // for output of program list to C64
-C64_Load_Result_t D64_uploadToC64(const uint8_t* const inName); // issue from C64 to load prog
-void D64_readProgramBinary(const uint8_t fTrack, const uint8_t fSect); // read full program binary and transmit
+const s64Data* D64_getDiskInfo(void);
+void D64_buildDirIndex(void); // walk the directory chain once and index all live entries
+uint8_t D64_getNumDirEntries(void);
+const D64_DirEntry_t* D64_getDirEntry(const uint8_t index); // entries in directory order
+uint8_t D64_getSortedDirIndex(const uint8_t rank); // directory index of the entry at rank in name order
+const D64_DirEntry_t* D64_findDirEntry(const uint8_t* const name); // padded name, NULL if not found
+bool D64_writeDirEntry(const D64_DirEntry_t* const entry); // into the first free slot, index is not updated
+
+void D64_Transfer_beginDirectory(D64_Transfer_t* const transfer); // LOAD"$", the rendered listing
+bool D64_Transfer_beginProgram(D64_Transfer_t* const transfer, const uint8_t track, const uint8_t sector);
+D64_Transfer_Result_t D64_Transfer_step(D64_Transfer_t* const transfer); // one listing line or one sector, never waits for the bus
+void D64_Transfer_end(D64_Transfer_t* const transfer);
+
+void D64_compilePattern(D64_Pattern_t* const pattern, const uint8_t* const name, const uint8_t length);
+const D64_DirEntry_t* D64_matchPattern(const D64_Pattern_t* const pattern); // first match in directory order
+
+void D64_NameMatch_begin(D64_NameMatch_t* const match);
+void D64_NameMatch_feed(D64_NameMatch_t* const match, const uint8_t byte);
+C64_Load_Result_t D64_NameMatch_end(D64_NameMatch_t* const match, const D64_DirEntry_t** const entry);
+
+void D64_renderListing(void); // render the "$" program once, called at mount
+void D64_invalidateListing(void); // call whenever the directory or BAM changes
+const uint8_t* D64_getListing(size_t* const size); // ready to send LOAD"$" stream
+uint8_t* D64_borrowListing(size_t* const size); // scratch ram, the listing is rendered again when next asked for
+uint16_t D64_getListingGeneration(void); // changes when the listing is rendered, a borrower from before has lost the ram
+
+void D64_BAM_load(const uint8_t* const buf); // parse the free maps of a BAM sector
+void D64_BAM_loadReadOnly(const uint16_t blocksFree); // for formats the allocator does not know, nothing is free
+void D64_BAM_store(uint8_t* const buf); // write the free maps back into a BAM sector
+bool D64_BAM_isDirty(void);
+bool D64_BAM_isFree(const uint8_t track, const uint8_t sector);
+uint16_t D64_BAM_getBlocksFree(void);
+bool D64_BAM_allocateFirst(uint8_t* const track, uint8_t* const sector); // first block of a new file
+bool D64_BAM_allocateNext(const uint8_t prevTrack, const uint8_t prevSector, const uint8_t interleave, uint8_t* const track, uint8_t* const sector);
+bool D64_BAM_allocateDirSector(const uint8_t prevSector, uint8_t* const sector); // extends the directory on its own track
+void D64_BAM_commit(void); // write the free maps back to the BAM sector if changed
+void D64_BAM_free(const uint8_t track, const uint8_t sector);
+
+uint32_t D64_crc32(uint32_t crc, const uint8_t* const data, const size_t size); // running, start at 0xffffffff and invert at the end
+uint32_t D64_Snapshot_fingerprint(void); // crc of the header, BAM and directory sectors
+bool D64_Snapshot_load(const uint32_t imageSize, const uint32_t imageCrc); // false if there is none for this image
+void D64_Snapshot_store(const uint32_t imageSize, const uint32_t imageCrc);
+
+/* raw module state, for the snapshot */
+void* D64_getDiskInfoState(size_t* const size);
+void* D64_getDirIndexState(size_t* const size);
+void* D64_BAM_getState(size_t* const size);
+void* D64_getListingState(size_t* const size);
+
+bool D64_File_open(D64_File_t* const file, const uint8_t track, const uint8_t sector);
+bool D64_File_read(D64_File_t* const file, uint8_t* const byte, bool* const isLast);
+bool D64_File_readBlock(D64_File_t* const file, const uint8_t** const data, uint16_t* const length, bool* const isLast); // rest of the current sector, valid until the next read
+void D64_File_prefetch(D64_File_t* const file); // fetch next linked sector, call while the bus is busy
+void D64_File_close(D64_File_t* const file);
+
+#define D64_COMMAND_CHANNEL (15)
+
+void D64_Command_begin(void); // data to the command channel follows
+void D64_Command_feed(const uint8_t byte);
+void D64_Command_end(void); // run what was received, called on EOI
+
+bool D64_FileWriter_open(D64_FileWriter_t* const writer, const uint8_t* const name, const uint8_t length, const uint8_t type); // raw OPEN name
+bool D64_FileWriter_write(D64_FileWriter_t* const writer, const uint8_t byte);
+bool D64_FileWriter_close(D64_FileWriter_t* const writer); // writes the last block, the directory entry and the BAM
+void D64_FileWriter_abandon(D64_FileWriter_t* const writer); // gives the blocks back, nothing goes into the directory
@@ -10,7 +10,44 @@
 
 #include <stdint.h>
 
-void Delay_us(const uint32_t time_us);
-void Delay_ns(const uint32_t time_ns);
+/* core clock the delays are counted in, CLOCK_SETUP 0 (FEI) in system_MKE06Z4.c */
+/* a different clock only costs accuracy until Delay_calibrate() has run */
+#ifndef DELAY_CORE_CLOCK_HZ
+#define DELAY_CORE_CLOCK_HZ (20971520uL)
+#endif
+
+/* 20.97 cycles per us does not truncate well, q8 is within 0.01% for waits up to 0.75 s */
+#define DELAY_CYCLES_PER_US_Q8  ((uint32_t) (((DELAY_CORE_CLOCK_HZ * 256ull) + 500000ull) / 1000000ull))
+#define DELAY_CYCLES_PER_NS_Q16 ((uint32_t) ((DELAY_CORE_CLOCK_HZ * 65536ull) / 1000000000ull))
+
+void Delay_cycles(const uint32_t cycles); // busy wait in core cycles, call overhead included
+void Delay_calibrate(void); // measure the wait loop against the PIT, once at boot
+
+/* constant arguments fold to a cycle count at compile time, there is no divider */
+/* at run time so a variable delay is scaled by multiply and shift (ns max ~1.6 ms) */
+/* both end in Delay_cycles(), which applies the Delay_calibrate() correction */
+__attribute__((always_inline)) static inline void Delay_us(const uint32_t time_us)
+{
+    if (__builtin_constant_p(time_us))
+    {
+        Delay_cycles((uint32_t) (((uint64_t) time_us * DELAY_CORE_CLOCK_HZ) / 1000000ull));
+    }
+    else
+    {
+        Delay_cycles((time_us * DELAY_CYCLES_PER_US_Q8) >> 8);
+    }
+}
+
+__attribute__((always_inline)) static inline void Delay_ns(const uint32_t time_ns)
+{
+    if (__builtin_constant_p(time_ns))
+    {
+        Delay_cycles((uint32_t) (((uint64_t) time_ns * DELAY_CORE_CLOCK_HZ) / 1000000000ull));
+    }
+    else
+    {
+        Delay_cycles((time_ns * DELAY_CYCLES_PER_NS_Q16) >> 16);
+    }
+}
 
 #endif /* PLATFORM_IFACE_DELAYIFACE_H_ */
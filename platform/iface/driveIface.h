@@ -0,0 +1,27 @@
+/*
+ * driveIface.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* uploaded 1541 drive code is run on an emulated 6502 with 2 KB of drive ram, */
+/* the VIA serial port drives the bus lines and the job queue reads the image */
+#define DRIVE_RAM_SIZE     (0x0800u)
+#define DRIVE_SLICE_CYCLES (2000u) // run per main loop pass, paced to 2 ms on the target
+
+void Drive_writeMemory(const uint16_t address, const uint8_t* const data, const uint8_t count); // M-W, ram is taken on the first write and again after a LOAD"$"
+void Drive_execute(const uint16_t address); // M-E, the bus is handed over to the drive code, ignored if the M-W ram was lost
+uint32_t Drive_run(const uint32_t cycles); // cycles actually run, stops early when the code returns to dos or leaves the port alone too long
+bool Drive_isRunning(void);
+void Drive_stop(void); // hand the bus back and give up the ram
+
+#ifdef WIN32
+uint32_t Drive_benchmark(const uint32_t cycles); // emulated cycles per second, host build only
+#endif
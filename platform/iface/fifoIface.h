@@ -17,6 +17,7 @@ typedef struct
     uint8_t head;
     uint8_t tail;
     size_t numBytes;
+    size_t numStored;
 } FIFO_t;
 
 typedef enum
@@ -11,14 +11,30 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/* smallest unit that can be erased, writes are batched up to this size */
+#define FLASH_ERASE_BLOCK_SIZE (4096u)
+
+/* reserved area after the largest image (d81 with error bytes), holds the mount snapshot */
+#define FLASH_SNAPSHOT_ADDRESS (0x000c9000u)
+#define FLASH_SNAPSHOT_SIZE    (4u * FLASH_ERASE_BLOCK_SIZE)
+
+/* after the snapshot the write cache journal, then the scratch blocks it */
+/* stages sectors in, one per commit in turn */
+#define FLASH_JOURNAL_ADDRESS    (FLASH_SNAPSHOT_ADDRESS + FLASH_SNAPSHOT_SIZE)
+#define FLASH_SCRATCH_ADDRESS    (FLASH_JOURNAL_ADDRESS + FLASH_ERASE_BLOCK_SIZE)
+#define FLASH_SCRATCH_NUM_BLOCKS (4u) // power of two
+
 typedef enum
 {
     Flash_Mode_Read,
     Flash_Mode_Write,
 } Flash_Mode_t;
 
+uint32_t Flash_getImageSize(void);
 uint8_t Flash_readByte(const uint32_t addr);
 void Flash_readBlock(const uint32_t addr, const size_t size, uint8_t* const dest);
 void Flash_seek(const uint32_t offset, const Flash_Mode_t mode);
+void Flash_eraseBlock(const uint32_t addr);
+void Flash_writeBlock(const uint32_t addr, const size_t size, const uint8_t* const src);
 
 #endif /* PLATFORM_IFACE_FLASHIFACE_H_ */
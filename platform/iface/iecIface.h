@@ -8,6 +8,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
 
 /* states of the disk drive */
 typedef enum
@@ -103,6 +105,12 @@ typedef enum
 #define IEC_TK_MAX  100
 #define IEC_DA_MIN   80 /* talk-attention ack. hold */
 #define IEC_FR_MIN   60 /* eoi ack. */
+#define IEC_TS_MAX 1000000 /* talker holding CLK with nothing to send */
+
+/* JiffyDOS, the host holds back the last bit of LISTEN/TALK to ask for it */
+#define IEC_JD_MIN  200 /* last command bit delay of a JiffyDOS host, experimental */
+#define IEC_JA_TYP  100 /* drive answers by holding DATA */
+#define IEC_JB_MIN   30 /* between bytes of a LOAD burst */
 
 #define IEC_TIMER_RESET 0
 
@@ -139,6 +147,49 @@ typedef enum
 
 void IEC_init(void);
 
-uint8_t IEC_TRANSMISSION_RX(void); /* recieve byte and return OK */
-uint8_t IEC_TRANSMISSION_TX(uint8_t IEC_SEND_BYTE, uint8_t EOI); /* transmit byte */
+/* outcome of a block transfer */
+typedef enum
+{
+    IEC_Result_Ok,
+    IEC_Result_Busy,    /* still on the bus */
+    IEC_Result_Aborted, /* ATN, or not addressed as talker */
+    IEC_Result_Timeout, /* listener did not acknowledge a frame */
+} IEC_Result_t;
+
+/* cartridge fastloaders whose drive code is recognized, their transfer is done natively */
+typedef enum
+{
+    IEC_Loader_None,
+    IEC_Loader_EpyxFastLoad,
+    IEC_Loader_ActionReplay,
+    IEC_Loader_FinalCartridge3,
+    IEC_Loader_Count,
+} IEC_Loader_t;
+
+/* received bytes are queued from the bus interrupts with these flags */
+#define IEC_RX_FLAG_ATN (0x0100u) /* sent under ATN, a command for this device */
+#define IEC_RX_FLAG_EOI (0x0200u) /* last byte of the transfer */
+
+/* receive queue use since IEC_init(), to size the queue */
+typedef struct
+{
+    uint8_t highWater;  /* most entries waiting at once */
+    uint16_t overflows; /* bytes and commands dropped because the queue was full */
+} IEC_RxStats_t;
+
+bool IEC_getCommand(uint8_t* const command); /* next command, false if none */
+bool IEC_getByte(uint8_t* const byte, bool* const isEOI); /* next data byte, false if none or a command is next */
+void IEC_getRxStats(IEC_RxStats_t* const stats);
+bool IEC_putByte(const uint8_t byte, const bool isEOI); /* queue a byte for the talker, false if full or not talking */
+IEC_Result_t IEC_sendBlock(const uint8_t* const buf, const size_t len, const bool eoiOnLast); /* Ok when accepted, buf is read until done */
+IEC_Result_t IEC_getBlockResult(void); /* Busy until the last byte of the block is acknowledged */
+void IEC_endTalk(void); /* nothing to send in this TALK, CLK is let go so the host sees an empty talk, until the next TALK */
+void IEC_setDirect(const bool isDirect); /* uploaded drive code drives the lines itself, the bus engine stands by */
+uint32_t IEC_getDirectClock(void); /* bus timer ticks counting up while direct, free running */
+uint32_t IEC_getClockTicks(const uint32_t us); /* IEC_getDirectClock() ticks in a time, convert once */
+void IEC_setLoader(const IEC_Loader_t loader); /* the next TALK uses this loader's protocol, until UNTALK */
+void IEC_setAdaptive(const bool isAdaptive); /* talker bit setup follows the host toward IEC_S_MIN, on by default */
+bool IEC_hasPending(void); /* commands, data or a timeout waiting for IEC_getCommand()/IEC_getByte()/IEC_getTimeout() */
+bool IEC_getTimeout(void); /* true once after a bus phase ran past its IEC_*_MAX, the bus is released and unaddressed */
+bool IEC_isTalking(void); /* addressed as talker and not interrupted by ATN or a missing listener */
 
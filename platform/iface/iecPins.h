@@ -0,0 +1,84 @@
+/*
+ * iecPins.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#pragma once
+
+#include "iecIface.h"
+
+#include <stdint.h>
+
+/* raw bus lines for the bus handlers and the drive code cpu, inlined so a */
+/* line access is a single IOPORT load or store instead of a call chain */
+#define IEC_PIN_INLINE __attribute__((always_inline)) static inline
+
+#ifndef WIN32
+#include "board.h"
+
+IEC_PIN_INLINE void IEC_setDAT(const IEC_Output_t value)
+{
+    if (IEC_Output_True == value)
+    {
+        BOARD_IEC_FGPIO->PSOR = BOARD_IEC_DATA_OUT_MASK;
+    }
+    else
+    {
+        BOARD_IEC_FGPIO->PCOR = BOARD_IEC_DATA_OUT_MASK;
+    }
+}
+
+IEC_PIN_INLINE void IEC_setCLK(const IEC_Output_t value)
+{
+    if (IEC_Output_True == value)
+    {
+        BOARD_IEC_FGPIO->PSOR = BOARD_IEC_CLK_OUT_MASK;
+    }
+    else
+    {
+        BOARD_IEC_FGPIO->PCOR = BOARD_IEC_CLK_OUT_MASK;
+    }
+}
+
+IEC_PIN_INLINE IEC_Input_t IEC_readDAT(void)
+{
+    return ((BOARD_IEC_FGPIO->PDIR & BOARD_IEC_DATA_IN_MASK) ? IEC_Input_False : IEC_Input_True);
+}
+
+IEC_PIN_INLINE IEC_Input_t IEC_readCLK(void)
+{
+    return ((BOARD_IEC_FGPIO->PDIR & BOARD_IEC_CLK_IN_MASK) ? IEC_Input_False : IEC_Input_True);
+}
+
+IEC_PIN_INLINE IEC_Input_t IEC_readATN(void)
+{
+    return ((BOARD_IEC_FGPIO->PDIR & BOARD_IEC_ATN_IN_MASK) ? IEC_Input_False : IEC_Input_True);
+}
+#else
+IEC_PIN_INLINE void IEC_setDAT(const IEC_Output_t value)
+{
+    (void) value;
+}
+
+IEC_PIN_INLINE void IEC_setCLK(const IEC_Output_t value)
+{
+    (void) value;
+}
+
+IEC_PIN_INLINE IEC_Input_t IEC_readDAT(void)
+{
+    return (IEC_Input_False);
+}
+
+IEC_PIN_INLINE IEC_Input_t IEC_readCLK(void)
+{
+    return (IEC_Input_False);
+}
+
+IEC_PIN_INLINE IEC_Input_t IEC_readATN(void)
+{
+    return (IEC_Input_False);
+}
+#endif
@@ -4,6 +4,22 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+/* Event payloads are copied into fixed slots, sized here at compile time. */
+#ifndef SM_PAYLOAD_SLOT_SIZE
+#define SM_PAYLOAD_SLOT_SIZE (16)
+#endif
+
+#ifndef SM_PAYLOAD_NUM_SLOTS
+#define SM_PAYLOAD_NUM_SLOTS (8)
+#endif
+
+typedef struct
+{
+	uint8_t inUse;
+	uint8_t highWater;
+	uint32_t failures; // payload too large or no slot left, the event was raised without it
+} SM_PoolStats_t;
+
 typedef struct
 {
 	bool raised;
@@ -56,3 +72,5 @@ bool SM_evDataCmp(const SM_Event_t* const ev, const size_t size);
 
 bool SM_evCmp(const SM_Event_t* const ev, const int32_t id);
 
+void SM_getPoolStats(SM_PoolStats_t* const stats);
+
@@ -0,0 +1,281 @@
+/*
+ * d64bam.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define D64_BAM_DIR_TRACK (D64_FIELD_SIZE_DIR_TRACK)
+
+static struct
+{
+    uint32_t freeMap[D64_BAM_NUM_TRACKS]; // bit n set: sector n is free
+    uint8_t freeCount[D64_BAM_NUM_TRACKS];
+    uint16_t blocksFree; // excluding the directory track
+    bool isDirty;
+} bam;
+
+static bool D64_BAM_findFree(const uint8_t track, const uint8_t start, uint8_t* const sector);
+static uint8_t D64_BAM_stepSector(const uint8_t track, const uint8_t prevSector, const uint8_t interleave);
+static void D64_BAM_take(const uint8_t track, const uint8_t sector);
+static uint8_t D64_BAM_countBits(uint32_t bits);
+
+void D64_BAM_load(const uint8_t* const buf)
+{
+    bam.blocksFree = 0;
+    bam.isDirty = false;
+
+    for (uint8_t track = 1; track <= D64_BAM_NUM_TRACKS; track++)
+    {
+        const uint8_t* const entry = &buf[D64_BAM_OFFSET_ENTRIES + (D64_BAM_ENTRY_SIZE * (track - 1))];
+        const uint32_t valid = (1uL << D64_getNumSectors(track)) - 1u;
+
+        /* trust the bitmap over the stored count */
+        bam.freeMap[track - 1] = (entry[1] | ((uint32_t) entry[2] << 8) | ((uint32_t) entry[3] << 16)) & valid;
+        bam.freeCount[track - 1] = D64_BAM_countBits(bam.freeMap[track - 1]);
+
+        if (D64_BAM_DIR_TRACK != track)
+        {
+            bam.blocksFree += bam.freeCount[track - 1];
+        }
+    }
+}
+
+void D64_BAM_loadReadOnly(const uint16_t blocksFree)
+{
+    /* the count is only shown in the listing, the allocator finds nothing */
+    memset(bam.freeMap, 0, sizeof(bam.freeMap));
+    memset(bam.freeCount, 0, sizeof(bam.freeCount));
+    bam.blocksFree = blocksFree;
+    bam.isDirty = false;
+}
+
+void D64_BAM_store(uint8_t* const buf)
+{
+    for (uint8_t track = 1; track <= D64_BAM_NUM_TRACKS; track++)
+    {
+        uint8_t* const entry = &buf[D64_BAM_OFFSET_ENTRIES + (D64_BAM_ENTRY_SIZE * (track - 1))];
+        const uint32_t bits = bam.freeMap[track - 1];
+
+        entry[0] = bam.freeCount[track - 1];
+        entry[1] = (uint8_t) (bits & 0xff);
+        entry[2] = (uint8_t) ((bits >> 8) & 0xff);
+        entry[3] = (uint8_t) ((bits >> 16) & 0xff);
+    }
+
+    bam.isDirty = false;
+}
+
+void D64_BAM_commit(void)
+{
+    uint8_t buf[D64_FIELD_SIZE_SECTOR];
+
+    if ((!bam.isDirty) || (!D64_readSector(D64_FIELD_SIZE_BAM_TRACK, D64_BAM_SECTOR, buf)))
+    {
+        return;
+    }
+
+    D64_BAM_store(buf);
+    D64_writeSector(D64_FIELD_SIZE_BAM_TRACK, D64_BAM_SECTOR, buf);
+}
+
+void* D64_BAM_getState(size_t* const size)
+{
+    *size = sizeof(bam);
+    return (&bam);
+}
+
+bool D64_BAM_isDirty(void)
+{
+    return (bam.isDirty);
+}
+
+bool D64_BAM_isFree(const uint8_t track, const uint8_t sector)
+{
+    if ((0 == track) || (track > D64_BAM_NUM_TRACKS) || (sector >= D64_getNumSectors(track)))
+    {
+        return (false);
+    }
+
+    return (0 != (bam.freeMap[track - 1] & (1uL << sector)));
+}
+
+uint16_t D64_BAM_getBlocksFree(void)
+{
+    return (bam.blocksFree);
+}
+
+bool D64_BAM_allocateFirst(uint8_t* const track, uint8_t* const sector)
+{
+    /* nearest track to the directory first, below before above, like the 1541 */
+    for (uint8_t distance = 1; distance < D64_BAM_NUM_TRACKS; distance++)
+    {
+        const uint8_t candidates[2] = {
+            (distance < D64_BAM_DIR_TRACK) ? (D64_BAM_DIR_TRACK - distance) : 0,
+            ((D64_BAM_DIR_TRACK + distance) <= D64_BAM_NUM_TRACKS) ? (D64_BAM_DIR_TRACK + distance) : 0,
+        };
+
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            if ((0 != candidates[i]) && D64_BAM_findFree(candidates[i], 0, sector))
+            {
+                *track = candidates[i];
+                D64_BAM_take(*track, *sector);
+                return (true);
+            }
+        }
+    }
+
+    return (false);
+}
+
+bool D64_BAM_allocateNext(const uint8_t prevTrack, const uint8_t prevSector, const uint8_t interleave, uint8_t* const track, uint8_t* const sector)
+{
+    if ((0 == prevTrack) || (prevTrack > D64_BAM_NUM_TRACKS) || (D64_BAM_DIR_TRACK == prevTrack))
+    {
+        return (D64_BAM_allocateFirst(track, sector));
+    }
+
+    /* stay on the track with the interleave */
+    const uint8_t start = D64_BAM_stepSector(prevTrack, prevSector, interleave);
+
+    if (D64_BAM_findFree(prevTrack, start, sector))
+    {
+        *track = prevTrack;
+        D64_BAM_take(*track, *sector);
+        return (true);
+    }
+
+    /* track is full, keep moving away from the directory, then try the other half */
+    const int8_t step = (prevTrack < D64_BAM_DIR_TRACK) ? -1 : 1;
+
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+        const int8_t dir = (0 == pass) ? step : -step;
+        int16_t t = (0 == pass) ? (prevTrack + dir) : (D64_BAM_DIR_TRACK + dir);
+
+        for (; (t >= 1) && (t <= D64_BAM_NUM_TRACKS); t += dir)
+        {
+            /* full tracks are skipped on the count alone */
+            if ((0 != bam.freeCount[t - 1]) && D64_BAM_findFree((uint8_t) t, start % D64_getNumSectors((uint8_t) t), sector))
+            {
+                *track = (uint8_t) t;
+                D64_BAM_take(*track, *sector);
+                return (true);
+            }
+        }
+    }
+
+    return (false);
+}
+
+bool D64_BAM_allocateDirSector(const uint8_t prevSector, uint8_t* const sector)
+{
+    const uint8_t start = D64_BAM_stepSector(D64_BAM_DIR_TRACK, prevSector, D64_BAM_DIR_INTERLEAVE);
+
+    if (D64_BAM_findFree(D64_BAM_DIR_TRACK, start, sector))
+    {
+        D64_BAM_take(D64_BAM_DIR_TRACK, *sector);
+        return (true);
+    }
+
+    return (false);
+}
+
+void D64_BAM_free(const uint8_t track, const uint8_t sector)
+{
+    if ((0 == track) || (track > D64_BAM_NUM_TRACKS) || (sector >= D64_getNumSectors(track)) || D64_BAM_isFree(track, sector))
+    {
+        return;
+    }
+
+    bam.freeMap[track - 1] |= (1uL << sector);
+    bam.freeCount[track - 1]++;
+    if (D64_BAM_DIR_TRACK != track)
+    {
+        bam.blocksFree++;
+    }
+
+    bam.isDirty = true;
+    D64_invalidateListing();
+}
+
+static bool D64_BAM_findFree(const uint8_t track, const uint8_t start, uint8_t* const sector)
+{
+    if (0 == bam.freeCount[track - 1])
+    {
+        return (false);
+    }
+
+    const uint8_t numSectors = D64_getNumSectors(track);
+    const uint32_t bits = bam.freeMap[track - 1];
+
+    uint8_t s = start;
+    for (uint8_t n = 0; n < numSectors; n++)
+    {
+        if (bits & (1uL << s))
+        {
+            *sector = s;
+            return (true);
+        }
+
+        s++;
+        if (s >= numSectors)
+        {
+            s = 0;
+        }
+    }
+
+    return (false);
+}
+
+static uint8_t D64_BAM_stepSector(const uint8_t track, const uint8_t prevSector, const uint8_t interleave)
+{
+    /* the 1541 steps back one sector when the interleave wraps the track */
+    const uint8_t numSectors = D64_getNumSectors(track);
+    uint8_t start = prevSector + interleave;
+
+    if (start >= numSectors)
+    {
+        start -= numSectors;
+        if (start > 0)
+        {
+            start--;
+        }
+    }
+
+    return (start);
+}
+
+static void D64_BAM_take(const uint8_t track, const uint8_t sector)
+{
+    bam.freeMap[track - 1] &= ~(1uL << sector);
+    bam.freeCount[track - 1]--;
+    if (D64_BAM_DIR_TRACK != track)
+    {
+        bam.blocksFree--;
+    }
+
+    bam.isDirty = true;
+    D64_invalidateListing();
+}
+
+static uint8_t D64_BAM_countBits(uint32_t bits)
+{
+    uint8_t count = 0;
+
+    while (bits)
+    {
+        bits &= (bits - 1u);
+        count++;
+    }
+
+    return (count);
+}
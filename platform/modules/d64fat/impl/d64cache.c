@@ -0,0 +1,371 @@
+/*
+ * d64cache.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include "flashIface.h"
+#include "timeEventIface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* only the newest data sector is held in ram, older sectors of the same */
+/* erase block are staged in a scratch block until the block is committed; */
+/* the directory track is rewritten all through a SAVE, its sectors stay in */
+/* ram until the flush */
+#define D64_CACHE_MASK        (FLASH_ERASE_BLOCK_SIZE - 1u)
+#define D64_CACHE_NUM_SECTORS (FLASH_ERASE_BLOCK_SIZE / D64_FIELD_SIZE_SECTOR)
+#define D64_CACHE_NUM_HELD    (2u) // the BAM and the directory sector being changed
+#define D64_CACHE_IDLE_MS     (500)
+
+#if (D64_CACHE_NUM_SECTORS > 16)
+#error "staged mask holds 16 sectors"
+#endif
+
+/* a commit is journaled: the scratch block is whole before its COMMIT record, */
+/* the target is erased and rewritten from it, then DONE follows; a COMMIT */
+/* without DONE is redone by D64_Cache_recover() */
+#define D64_CACHE_RECORD_COMMIT (0x54494d43uL) // "CMIT"
+#define D64_CACHE_RECORD_DONE   (0x454e4f44uL) // "DONE"
+#define D64_CACHE_RECORD_ERASED (0xffffffffuL)
+
+typedef struct
+{
+    uint32_t magic;    // D64_CACHE_RECORD_COMMIT or D64_CACHE_RECORD_DONE
+    uint32_t target;   // erase block rewritten from the scratch block
+    uint32_t sequence; // of the commit, picks the scratch block
+    uint32_t check;    // ~(magic ^ target ^ sequence), a torn record does not match
+} D64_Cache_Record_t;
+
+#define D64_CACHE_NUM_RECORDS (FLASH_ERASE_BLOCK_SIZE / sizeof(D64_Cache_Record_t))
+
+typedef struct
+{
+    uint8_t data[D64_FIELD_SIZE_SECTOR];
+    uint32_t offset;
+    bool isUsed;
+} D64_Cache_Held_t;
+
+static struct
+{
+    uint8_t data[D64_FIELD_SIZE_SECTOR]; // newest sector, not staged yet
+    uint8_t copy[D64_FIELD_SIZE_SECTOR]; // bounce buffer for the commit, kept off the stack
+    D64_Cache_Held_t held[D64_CACHE_NUM_HELD];
+    uint32_t base;        // flash address of the block being changed
+    uint32_t sequence;    // of the next commit
+    uint16_t journalNext; // first free record
+    uint16_t stagedMask;  // bit n set: sector n is in the scratch block, which is erased when this goes from zero
+    uint8_t current;      // index of the sector in data
+    bool isPending;       // data holds a sector that is not in flash yet
+    TimeEvent_t idle;
+} cache;
+
+static bool D64_Cache_isStaging(void);
+static void D64_Cache_stage(void);
+static void D64_Cache_commit(const uint32_t base);
+static void D64_Cache_copyBack(const uint32_t target, const uint32_t scratch);
+static void D64_Cache_append(const uint32_t magic, const uint32_t target, const uint32_t sequence);
+static uint32_t D64_Cache_getScratch(const uint32_t sequence);
+static D64_Cache_Held_t* D64_Cache_findHeld(const uint32_t offset);
+
+void D64_Cache_recover(void)
+{
+    D64_Cache_Record_t record;
+    D64_Cache_Record_t last = { .magic = D64_CACHE_RECORD_ERASED };
+    uint16_t i;
+
+    /* records are appended in order, the first erased one ends the journal */
+    for (i = 0; i < D64_CACHE_NUM_RECORDS; i++)
+    {
+        Flash_readBlock(FLASH_JOURNAL_ADDRESS + (i * sizeof(record)), sizeof(record), (uint8_t*) &record);
+
+        if ((D64_CACHE_RECORD_ERASED == record.magic) && (D64_CACHE_RECORD_ERASED == record.target)
+            && (D64_CACHE_RECORD_ERASED == record.sequence) && (D64_CACHE_RECORD_ERASED == record.check))
+        {
+            break;
+        }
+
+        if (record.check == ~(record.magic ^ record.target ^ record.sequence))
+        {
+            last = record;
+        }
+    }
+
+    cache.journalNext = i;
+    cache.sequence = 0;
+    cache.stagedMask = 0;
+    cache.isPending = false;
+
+    for (uint8_t k = 0; k < D64_CACHE_NUM_HELD; k++)
+    {
+        cache.held[k].isUsed = false;
+    }
+
+    if ((D64_CACHE_RECORD_COMMIT == last.magic) || (D64_CACHE_RECORD_DONE == last.magic))
+    {
+        cache.sequence = last.sequence + 1u;
+    }
+
+    if (D64_CACHE_RECORD_COMMIT == last.magic)
+    {
+        /* power went while the target was rewritten, the scratch block is whole */
+        D64_Cache_copyBack(last.target, D64_Cache_getScratch(last.sequence));
+        D64_Cache_append(D64_CACHE_RECORD_DONE, last.target, last.sequence);
+    }
+}
+
+bool D64_Cache_readSector(const uint32_t offset, uint8_t* const buf)
+{
+    const D64_Cache_Held_t* const held = D64_Cache_findHeld(offset);
+
+    if (NULL != held)
+    {
+        memcpy(buf, held->data, D64_FIELD_SIZE_SECTOR);
+        return (true);
+    }
+
+    if (D64_Cache_isStaging() && (cache.base == (offset & ~D64_CACHE_MASK)))
+    {
+        const uint8_t n = (uint8_t) ((offset & D64_CACHE_MASK) / D64_FIELD_SIZE_SECTOR);
+
+        if ((cache.isPending) && (cache.current == n))
+        {
+            memcpy(buf, cache.data, D64_FIELD_SIZE_SECTOR);
+            return (true);
+        }
+
+        if (cache.stagedMask & (1u << n))
+        {
+            Flash_readBlock(D64_Cache_getScratch(cache.sequence) + (n * D64_FIELD_SIZE_SECTOR), D64_FIELD_SIZE_SECTOR, buf);
+            return (true);
+        }
+    }
+
+    Flash_readBlock(offset, D64_FIELD_SIZE_SECTOR, buf);
+
+    return (true);
+}
+
+void D64_Cache_writeSector(const uint32_t offset, const uint8_t* const buf, const bool isHeld)
+{
+    if (isHeld)
+    {
+        D64_Cache_Held_t* held = D64_Cache_findHeld(offset);
+
+        for (uint8_t k = 0; (NULL == held) && (k < D64_CACHE_NUM_HELD); k++)
+        {
+            if (!cache.held[k].isUsed)
+            {
+                held = &cache.held[k];
+            }
+        }
+
+        if (NULL == held)
+        {
+            /* more of the directory track than fits, commit what is there */
+            D64_Cache_flush();
+            held = &cache.held[0];
+        }
+
+        memcpy(held->data, buf, D64_FIELD_SIZE_SECTOR);
+        held->offset = offset;
+        held->isUsed = true;
+        return;
+    }
+
+    const uint32_t base = offset & ~D64_CACHE_MASK;
+    const uint8_t n = (uint8_t) ((offset & D64_CACHE_MASK) / D64_FIELD_SIZE_SECTOR);
+
+    if (D64_Cache_isStaging() && (cache.base != base))
+    {
+        /* moving to another block, the old one has to go out first */
+        D64_Cache_commit(cache.base);
+    }
+
+    if ((cache.isPending) && (cache.current != n))
+    {
+        D64_Cache_stage();
+    }
+
+    if (cache.stagedMask & (1u << n))
+    {
+        /* a staged sector cannot be programmed twice, commit and start over */
+        D64_Cache_commit(cache.base);
+    }
+
+    memcpy(cache.data, buf, D64_FIELD_SIZE_SECTOR);
+    cache.base = base;
+    cache.current = n;
+    cache.isPending = true;
+
+    TimeEvent_start(&cache.idle, D64_CACHE_IDLE_MS);
+}
+
+void D64_Cache_flush(void)
+{
+    /* the staged block first, its scratch block is the next one to use */
+    if (D64_Cache_isStaging())
+    {
+        D64_Cache_commit(cache.base);
+    }
+
+    /* then the rest of the directory track, a block at a time */
+    for (uint8_t k = 0; k < D64_CACHE_NUM_HELD; k++)
+    {
+        if (cache.held[k].isUsed)
+        {
+            D64_Cache_commit(cache.held[k].offset & ~D64_CACHE_MASK);
+        }
+    }
+}
+
+void D64_Cache_poll(void)
+{
+    /* the directory track waits for the flush at the end of the SAVE */
+    if (D64_Cache_isStaging() && TimeEvent_isExpired(&cache.idle))
+    {
+        D64_Cache_commit(cache.base);
+    }
+}
+
+bool D64_Cache_isDirty(void)
+{
+    for (uint8_t k = 0; k < D64_CACHE_NUM_HELD; k++)
+    {
+        if (cache.held[k].isUsed)
+        {
+            return (true);
+        }
+    }
+
+    return (D64_Cache_isStaging());
+}
+
+static bool D64_Cache_isStaging(void)
+{
+    return ((cache.isPending) || (0 != cache.stagedMask));
+}
+
+static void D64_Cache_stage(void)
+{
+    const uint32_t scratch = D64_Cache_getScratch(cache.sequence);
+
+    /* erased pages program without another erase, each slot once per commit */
+    if (0 == cache.stagedMask)
+    {
+        Flash_eraseBlock(scratch);
+    }
+
+    Flash_writeBlock(scratch + (cache.current * D64_FIELD_SIZE_SECTOR), D64_FIELD_SIZE_SECTOR, cache.data);
+    cache.stagedMask |= (uint16_t) (1u << cache.current);
+    cache.isPending = false;
+}
+
+static void D64_Cache_commit(const uint32_t base)
+{
+    /* only the staged block has sectors in the scratch block already */
+    const bool isStaged = D64_Cache_isStaging() && (cache.base == base);
+    const uint32_t scratch = D64_Cache_getScratch(cache.sequence);
+
+    if ((!isStaged) || (0 == cache.stagedMask))
+    {
+        Flash_eraseBlock(scratch);
+    }
+
+    /* the scratch block gets the whole new block, held sectors in it go along */
+    for (uint8_t n = 0; n < D64_CACHE_NUM_SECTORS; n++)
+    {
+        const uint32_t offset = base + (n * D64_FIELD_SIZE_SECTOR);
+        D64_Cache_Held_t* const held = D64_Cache_findHeld(offset);
+        const uint8_t* src = cache.copy;
+
+        if (NULL != held)
+        {
+            src = held->data;
+            held->isUsed = false;
+        }
+        else if (isStaged && (cache.isPending) && (cache.current == n))
+        {
+            src = cache.data;
+        }
+        else if (isStaged && (cache.stagedMask & (1u << n)))
+        {
+            continue;
+        }
+        else
+        {
+            Flash_readBlock(offset, D64_FIELD_SIZE_SECTOR, cache.copy);
+        }
+
+        Flash_writeBlock(scratch + (n * D64_FIELD_SIZE_SECTOR), D64_FIELD_SIZE_SECTOR, src);
+    }
+
+    /* from here a power cut is finished by D64_Cache_recover() */
+    D64_Cache_append(D64_CACHE_RECORD_COMMIT, base, cache.sequence);
+    D64_Cache_copyBack(base, scratch);
+    D64_Cache_append(D64_CACHE_RECORD_DONE, base, cache.sequence);
+
+    /* the next commit stages in the next scratch block */
+    cache.sequence++;
+
+    if (isStaged)
+    {
+        cache.stagedMask = 0;
+        cache.isPending = false;
+    }
+}
+
+static void D64_Cache_copyBack(const uint32_t target, const uint32_t scratch)
+{
+    Flash_eraseBlock(target);
+
+    for (uint8_t n = 0; n < D64_CACHE_NUM_SECTORS; n++)
+    {
+        Flash_readBlock(scratch + (n * D64_FIELD_SIZE_SECTOR), D64_FIELD_SIZE_SECTOR, cache.copy);
+        Flash_writeBlock(target + (n * D64_FIELD_SIZE_SECTOR), D64_FIELD_SIZE_SECTOR, cache.copy);
+    }
+}
+
+static void D64_Cache_append(const uint32_t magic, const uint32_t target, const uint32_t sequence)
+{
+    /* erased between commits only, a COMMIT always has room for its DONE */
+    if ((D64_CACHE_RECORD_COMMIT == magic) && ((cache.journalNext + 2u) > D64_CACHE_NUM_RECORDS))
+    {
+        Flash_eraseBlock(FLASH_JOURNAL_ADDRESS);
+        cache.journalNext = 0;
+    }
+
+    const D64_Cache_Record_t record = {
+        .magic = magic,
+        .target = target,
+        .sequence = sequence,
+        .check = ~(magic ^ target ^ sequence),
+    };
+
+    Flash_writeBlock(FLASH_JOURNAL_ADDRESS + (cache.journalNext * sizeof(record)), sizeof(record), (const uint8_t*) &record);
+    cache.journalNext++;
+}
+
+static uint32_t D64_Cache_getScratch(const uint32_t sequence)
+{
+    return (FLASH_SCRATCH_ADDRESS + ((sequence & (FLASH_SCRATCH_NUM_BLOCKS - 1u)) * FLASH_ERASE_BLOCK_SIZE));
+}
+
+static D64_Cache_Held_t* D64_Cache_findHeld(const uint32_t offset)
+{
+    for (uint8_t k = 0; k < D64_CACHE_NUM_HELD; k++)
+    {
+        if (cache.held[k].isUsed && (cache.held[k].offset == offset))
+        {
+            return (&cache.held[k]);
+        }
+    }
+
+    return (NULL);
+}
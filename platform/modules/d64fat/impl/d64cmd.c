@@ -0,0 +1,148 @@
+/*
+ * d64cmd.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include "iecIface.h"
+#include "driveIface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* "M-W" lo hi n and up to 32 bytes of drive code, other commands are shorter */
+#define D64_COMMAND_MAX_SIZE (48u)
+
+#define D64_COMMAND_OFFSET_ADDRESS (3u)
+#define D64_COMMAND_OFFSET_COUNT   (5u)
+#define D64_COMMAND_OFFSET_DATA    (6u)
+
+/* drive code of a cartridge fastloader, as uploaded with M-W before its M-E */
+typedef struct
+{
+    uint32_t crc;     // over address and payload of every M-W, in order
+    uint16_t size;    // payload bytes
+    uint16_t execute; // M-E address
+    IEC_Loader_t loader;
+} D64_LoaderSignature_t;
+
+/* a loader is only done natively once its upload is known byte for byte; */
+/* entries come from bus captures of the cartridges, size 0 ends the list */
+/* @todo add Epyx FastLoad, Action Replay and Final Cartridge III as captured */
+static const D64_LoaderSignature_t loaderSignatures[] = {
+    { 0x00000000uL, 0, 0x0000, IEC_Loader_None },
+};
+
+#define D64_NUM_LOADER_SIGNATURES (sizeof(loaderSignatures) / sizeof(loaderSignatures[0]))
+
+static struct
+{
+    uint8_t data[D64_COMMAND_MAX_SIZE];
+    uint8_t length;
+    uint32_t uploadCrc;  // drive code since the last M-E
+    uint16_t uploadSize;
+} command = {
+    .uploadCrc = 0xffffffffuL,
+};
+
+static void D64_Command_memoryWrite(void);
+static void D64_Command_memoryExecute(void);
+
+void D64_Command_begin(void)
+{
+    command.length = 0;
+}
+
+void D64_Command_feed(const uint8_t byte)
+{
+    if (command.length < D64_COMMAND_MAX_SIZE)
+    {
+        command.data[command.length] = byte;
+        command.length++;
+    }
+}
+
+void D64_Command_end(void)
+{
+    /* only the memory commands are looked at, the rest is dropped as before */
+    if ((command.length >= D64_COMMAND_OFFSET_COUNT) && ('M' == command.data[0]) && ('-' == command.data[1]))
+    {
+        switch (command.data[2])
+        {
+            case 'W':
+                D64_Command_memoryWrite();
+                break;
+
+            case 'E':
+                D64_Command_memoryExecute();
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    command.length = 0;
+}
+
+static void D64_Command_memoryWrite(void)
+{
+    if (command.length < D64_COMMAND_OFFSET_DATA)
+    {
+        return;
+    }
+
+    /* a short write is hashed as far as it goes, it will not match anything */
+    uint8_t count = command.data[D64_COMMAND_OFFSET_COUNT];
+    if (count > (command.length - D64_COMMAND_OFFSET_DATA))
+    {
+        count = command.length - D64_COMMAND_OFFSET_DATA;
+    }
+
+    command.uploadCrc = D64_crc32(command.uploadCrc, &command.data[D64_COMMAND_OFFSET_ADDRESS], 2);
+    command.uploadCrc = D64_crc32(command.uploadCrc, &command.data[D64_COMMAND_OFFSET_DATA], count);
+    command.uploadSize += count;
+
+    /* kept for the cpu too, in case it is not a loader we know */
+    const uint16_t address = command.data[D64_COMMAND_OFFSET_ADDRESS] | (command.data[D64_COMMAND_OFFSET_ADDRESS + 1u] << 8);
+    Drive_writeMemory(address, &command.data[D64_COMMAND_OFFSET_DATA], count);
+}
+
+static void D64_Command_memoryExecute(void)
+{
+    const uint16_t execute = command.data[D64_COMMAND_OFFSET_ADDRESS] | (command.data[D64_COMMAND_OFFSET_ADDRESS + 1u] << 8);
+    const uint32_t crc = ~command.uploadCrc;
+
+    IEC_Loader_t loader = IEC_Loader_None;
+
+    for (size_t i = 0; (i < D64_NUM_LOADER_SIGNATURES) && (0 != loaderSignatures[i].size); i++)
+    {
+        const D64_LoaderSignature_t* const signature = &loaderSignatures[i];
+
+        if ((crc == signature->crc) && (command.uploadSize == signature->size) && (execute == signature->execute))
+        {
+            loader = signature->loader;
+            break;
+        }
+    }
+
+    /* a known loader is done natively, anything else runs on the drive cpu */
+    IEC_setLoader(loader);
+
+    if (IEC_Loader_None != loader)
+    {
+        Drive_stop();
+    }
+    else
+    {
+        Drive_execute(execute);
+    }
+
+    command.uploadCrc = 0xffffffffuL;
+    command.uploadSize = 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * d64dir.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* open addressed hash table, power of two and well above max entries */
+#define D64_DIR_HASH_SIZE  (256u)
+#define D64_DIR_HASH_MASK  (D64_DIR_HASH_SIZE - 1u)
+#define D64_DIR_HASH_EMPTY (0xffu)
+
+/* the directory chain can never be longer than the directory track */
+#define D64_DIR_MAX_SECTORS (D64_DIR_MAX_ENTRIES / D64_DIR_ENTRIES_PER_SECTOR)
+
+static struct
+{
+    D64_DirEntry_t entry[D64_DIR_MAX_ENTRIES];
+    uint8_t hashTable[D64_DIR_HASH_SIZE];
+    uint8_t sorted[D64_DIR_MAX_ENTRIES]; // entry indices in name order
+    uint8_t numEntries;
+} dir;
+
+static uint16_t D64_hashName(const uint8_t* const name);
+static void D64_addDirEntry(const uint8_t* const raw);
+static void D64_sortDirIndex(void);
+static void D64_fillDirSlot(uint8_t* const raw, const D64_DirEntry_t* const entry);
+
+void D64_buildDirIndex(void)
+{
+    uint8_t buf[D64_FIELD_SIZE_SECTOR];
+
+    memset(dir.hashTable, D64_DIR_HASH_EMPTY, sizeof(dir.hashTable));
+    dir.numEntries = 0;
+
+    uint8_t track = D64_getGeometry()->dirTrack;
+    uint8_t sector = D64_getGeometry()->dirSector;
+
+    for (uint8_t n = 0; (n < D64_DIR_MAX_SECTORS) && (0 != track); n++)
+    {
+        if (!D64_readSector(track, sector, buf))
+        {
+            break;
+        }
+
+        for (uint16_t k = 0; k < D64_FIELD_SIZE_SECTOR; k += D64_FIELD_SIZE_DIR_ENTRY)
+        {
+            D64_addDirEntry(&buf[k]);
+        }
+
+        track = buf[D64_DIR_OFFSET_NEXT_TRACK];
+        sector = buf[D64_DIR_OFFSET_NEXT_SECTOR];
+    }
+
+    D64_sortDirIndex();
+}
+
+uint8_t D64_getNumDirEntries(void)
+{
+    return (dir.numEntries);
+}
+
+const D64_DirEntry_t* D64_getDirEntry(const uint8_t index)
+{
+    if (index < dir.numEntries)
+    {
+        return (&dir.entry[index]);
+    }
+
+    return (NULL);
+}
+
+void* D64_getDirIndexState(size_t* const size)
+{
+    *size = sizeof(dir);
+    return (&dir);
+}
+
+uint8_t D64_getSortedDirIndex(const uint8_t rank)
+{
+    return (dir.sorted[rank]);
+}
+
+const D64_DirEntry_t* D64_findDirEntry(const uint8_t* const name)
+{
+    const uint16_t hash = D64_hashName(name);
+    uint8_t slot = hash & D64_DIR_HASH_MASK;
+
+    for (uint16_t probe = 0; probe < D64_DIR_HASH_SIZE; probe++)
+    {
+        const uint8_t index = dir.hashTable[slot];
+
+        if (D64_DIR_HASH_EMPTY == index)
+        {
+            break;
+        }
+
+        const D64_DirEntry_t* const entry = &dir.entry[index];
+        if ((hash == entry->hash) && (0 == memcmp(name, entry->name, D64_FIELD_SIZE_NAME)))
+        {
+            return (entry);
+        }
+
+        slot = (slot + 1u) & D64_DIR_HASH_MASK;
+    }
+
+    return (NULL);
+}
+
+bool D64_writeDirEntry(const D64_DirEntry_t* const entry)
+{
+    uint8_t buf[D64_FIELD_SIZE_SECTOR];
+
+    uint8_t track = D64_FIELD_SIZE_DIR_TRACK;
+    uint8_t sector = D64_DIR_FIRST_SECTOR;
+
+    for (uint8_t n = 0; n < D64_DIR_MAX_SECTORS; n++)
+    {
+        if (!D64_readSector(track, sector, buf))
+        {
+            return (false);
+        }
+
+        /* first scratched or unused slot, like the drive does */
+        for (uint16_t k = 0; k < D64_FIELD_SIZE_SECTOR; k += D64_FIELD_SIZE_DIR_ENTRY)
+        {
+            if (0 == buf[k + D64_DIR_OFFSET_TYPE])
+            {
+                D64_fillDirSlot(&buf[k], entry);
+                return (D64_writeSector(track, sector, buf));
+            }
+        }
+
+        if (0 == buf[D64_DIR_OFFSET_NEXT_TRACK])
+        {
+            /* directory is full, link in another sector */
+            uint8_t next;
+            if (!D64_BAM_allocateDirSector(sector, &next))
+            {
+                return (false);
+            }
+
+            buf[D64_DIR_OFFSET_NEXT_TRACK] = D64_FIELD_SIZE_DIR_TRACK;
+            buf[D64_DIR_OFFSET_NEXT_SECTOR] = next;
+            D64_writeSector(track, sector, buf);
+
+            memset(buf, 0, sizeof(buf));
+            buf[D64_DIR_OFFSET_NEXT_SECTOR] = 0xff;
+            D64_fillDirSlot(&buf[0], entry);
+            return (D64_writeSector(D64_FIELD_SIZE_DIR_TRACK, next, buf));
+        }
+
+        track = buf[D64_DIR_OFFSET_NEXT_TRACK];
+        sector = buf[D64_DIR_OFFSET_NEXT_SECTOR];
+    }
+
+    return (false);
+}
+
+static void D64_fillDirSlot(uint8_t* const raw, const D64_DirEntry_t* const entry)
+{
+    /* the first two bytes of slot 0 are the sector link, leave them alone */
+    memset(&raw[D64_DIR_OFFSET_TYPE], 0, D64_FIELD_SIZE_DIR_ENTRY - D64_DIR_OFFSET_TYPE);
+
+    raw[D64_DIR_OFFSET_TYPE] = entry->type;
+    raw[D64_DIR_OFFSET_TRACK] = entry->track;
+    raw[D64_DIR_OFFSET_SECTOR] = entry->sector;
+    memcpy(&raw[D64_DIR_OFFSET_NAME], entry->name, D64_FIELD_SIZE_NAME);
+    raw[D64_DIR_OFFSET_BLOCKS] = (uint8_t) (entry->blocks & 0xff);
+    raw[D64_DIR_OFFSET_BLOCKS + 1] = (uint8_t) (entry->blocks >> 8);
+}
+
+static void D64_addDirEntry(const uint8_t* const raw)
+{
+    /* type 0 means the entry is scratched (or never used) */
+    if ((0 == raw[D64_DIR_OFFSET_TYPE]) || (dir.numEntries >= D64_DIR_MAX_ENTRIES))
+    {
+        return;
+    }
+
+    const uint8_t index = dir.numEntries;
+    D64_DirEntry_t* const entry = &dir.entry[index];
+
+    memcpy(entry->name, &raw[D64_DIR_OFFSET_NAME], D64_FIELD_SIZE_NAME);
+    entry->hash = D64_hashName(entry->name);
+    entry->type = raw[D64_DIR_OFFSET_TYPE];
+    entry->track = raw[D64_DIR_OFFSET_TRACK];
+    entry->sector = raw[D64_DIR_OFFSET_SECTOR];
+    entry->blocks = raw[D64_DIR_OFFSET_BLOCKS] + (raw[D64_DIR_OFFSET_BLOCKS + 1] * 256u);
+
+    dir.numEntries++;
+
+    /* linear probing, the first entry in directory order wins on duplicates */
+    uint8_t slot = entry->hash & D64_DIR_HASH_MASK;
+    while (D64_DIR_HASH_EMPTY != dir.hashTable[slot])
+    {
+        const D64_DirEntry_t* const other = &dir.entry[dir.hashTable[slot]];
+        if ((entry->hash == other->hash) && (0 == memcmp(entry->name, other->name, D64_FIELD_SIZE_NAME)))
+        {
+            return;
+        }
+        slot = (slot + 1u) & D64_DIR_HASH_MASK;
+    }
+
+    dir.hashTable[slot] = index;
+}
+
+static void D64_sortDirIndex(void)
+{
+    /* insertion sort, only done once at mount */
+    for (uint8_t i = 0; i < dir.numEntries; i++)
+    {
+        const uint8_t index = i;
+        uint8_t k = i;
+
+        while ((k > 0) && (memcmp(dir.entry[dir.sorted[k - 1]].name, dir.entry[index].name, D64_FIELD_SIZE_NAME) > 0))
+        {
+            dir.sorted[k] = dir.sorted[k - 1];
+            k--;
+        }
+
+        dir.sorted[k] = index;
+    }
+}
+
+static uint16_t D64_hashName(const uint8_t* const name)
+{
+    /* 32-bit FNV-1a folded to 16 bits */
+    uint32_t hash = 2166136261u;
+
+    for (uint8_t i = 0; i < D64_FIELD_SIZE_NAME; i++)
+    {
+        hash ^= name[i];
+        hash *= 16777619u;
+    }
+
+    return ((uint16_t) (hash ^ (hash >> 16)));
+}
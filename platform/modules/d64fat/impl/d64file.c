@@ -0,0 +1,316 @@
+/*
+ * d64file.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* a file can never be longer than the largest image (d81), stops looped chains */
+#define D64_FILE_MAX_BLOCKS (3200)
+
+/* file data starts after the track/sector link */
+#define D64_FILE_DATA_START (2)
+
+/* flash has no rotational latency, consecutive blocks of a saved file are */
+/* kept next to each other so they fill whole erase blocks in the write cache */
+#define D64_FILE_WRITE_INTERLEAVE (1)
+
+static uint16_t D64_File_getDataEnd(const uint8_t* const buf);
+static void D64_FileWriter_drop(D64_FileWriter_t* const writer);
+
+bool D64_File_open(D64_File_t* const file, const uint8_t track, const uint8_t sector)
+{
+    memset(file, 0, sizeof(D64_File_t));
+
+    if (!D64_readSector(track, sector, file->buffer[0]))
+    {
+        return (false);
+    }
+
+    file->current = 0;
+    file->position = D64_FILE_DATA_START;
+    file->length = D64_File_getDataEnd(file->buffer[0]);
+    file->numBlocks = 1;
+    file->isOpen = true;
+
+    return (true);
+}
+
+bool D64_File_read(D64_File_t* const file, uint8_t* const byte, bool* const isLast)
+{
+    if (!file->isOpen)
+    {
+        return (false);
+    }
+
+    if (file->position >= file->length)
+    {
+        /* current sector is done, swap in the next one (fetch now if not done yet) */
+        D64_File_prefetch(file);
+
+        if (!file->isPrefetched)
+        {
+            return (false);
+        }
+
+        file->current ^= 1u;
+        file->isPrefetched = false;
+        file->position = D64_FILE_DATA_START;
+        file->length = D64_File_getDataEnd(file->buffer[file->current]);
+
+        if (file->position >= file->length)
+        {
+            return (false);
+        }
+    }
+
+    *byte = file->buffer[file->current][file->position];
+    file->position++;
+
+    if (isLast)
+    {
+        *isLast = false;
+
+        if (file->position >= file->length)
+        {
+            /* last byte of this sector, it is the last of the file unless a next sector can be had */
+            D64_File_prefetch(file);
+            *isLast = !file->isPrefetched;
+        }
+    }
+
+    return (true);
+}
+
+bool D64_File_readBlock(D64_File_t* const file, const uint8_t** const data, uint16_t* const length, bool* const isLast)
+{
+    if (!file->isOpen)
+    {
+        return (false);
+    }
+
+    if (file->position >= file->length)
+    {
+        D64_File_prefetch(file);
+
+        if (!file->isPrefetched)
+        {
+            return (false);
+        }
+
+        file->current ^= 1u;
+        file->isPrefetched = false;
+        file->position = D64_FILE_DATA_START;
+        file->length = D64_File_getDataEnd(file->buffer[file->current]);
+
+        if (file->position >= file->length)
+        {
+            return (false);
+        }
+    }
+
+    /* the rest of the sector, straight from the buffer */
+    const uint8_t* const cur = file->buffer[file->current];
+
+    *data = &cur[file->position];
+    *length = file->length - file->position;
+    *isLast = (0 == cur[D64_DIR_OFFSET_NEXT_TRACK]);
+    file->position = file->length;
+
+    return (true);
+}
+
+void D64_File_prefetch(D64_File_t* const file)
+{
+    if ((!file->isOpen) || (file->isPrefetched) || (file->prefetchFailed))
+    {
+        return;
+    }
+
+    const uint8_t* const cur = file->buffer[file->current];
+
+    if (0 == cur[D64_DIR_OFFSET_NEXT_TRACK])
+    {
+        return; // last sector in chain
+    }
+
+    if ((file->numBlocks >= D64_FILE_MAX_BLOCKS)
+        || (!D64_readSector(cur[D64_DIR_OFFSET_NEXT_TRACK], cur[D64_DIR_OFFSET_NEXT_SECTOR], file->buffer[file->current ^ 1u])))
+    {
+        file->prefetchFailed = true;
+        return;
+    }
+
+    file->numBlocks++;
+    file->isPrefetched = true;
+}
+
+void D64_File_close(D64_File_t* const file)
+{
+    file->isOpen = false;
+    file->isPrefetched = false;
+}
+
+bool D64_FileWriter_open(D64_FileWriter_t* const writer, const uint8_t* const name, const uint8_t length, const uint8_t type)
+{
+    D64_Pattern_t pattern;
+
+    memset(writer, 0, sizeof(D64_FileWriter_t));
+    D64_compilePattern(&pattern, name, length);
+
+    /* a new file needs a plain name that is not taken yet */
+    if ((D64_Pattern_Kind_Literal != pattern.kind)
+        || (D64_NAME_PADDING == pattern.literal[0])
+        || ('$' == pattern.literal[0])
+        || (NULL != D64_findDirEntry(pattern.literal)))
+    {
+        return (false);
+    }
+
+    if (!D64_BAM_allocateFirst(&writer->track, &writer->sector))
+    {
+        return (false);
+    }
+
+    memcpy(writer->name, pattern.literal, D64_FIELD_SIZE_NAME);
+    writer->type = type;
+    writer->firstTrack = writer->track;
+    writer->firstSector = writer->sector;
+    writer->position = D64_FILE_DATA_START;
+    writer->numBlocks = 1;
+    writer->isOpen = true;
+
+    return (true);
+}
+
+bool D64_FileWriter_write(D64_FileWriter_t* const writer, const uint8_t byte)
+{
+    if ((!writer->isOpen) || (writer->isFull))
+    {
+        return (false);
+    }
+
+    if (writer->position >= D64_FIELD_SIZE_SECTOR)
+    {
+        /* block is full, link it to the next one and hand it to the write cache */
+        uint8_t track;
+        uint8_t sector;
+
+        if (!D64_BAM_allocateNext(writer->track, writer->sector, D64_FILE_WRITE_INTERLEAVE, &track, &sector))
+        {
+            writer->isFull = true;
+            return (false);
+        }
+
+        writer->buffer[D64_DIR_OFFSET_NEXT_TRACK] = track;
+        writer->buffer[D64_DIR_OFFSET_NEXT_SECTOR] = sector;
+        D64_writeSector(writer->track, writer->sector, writer->buffer);
+
+        writer->track = track;
+        writer->sector = sector;
+        writer->position = D64_FILE_DATA_START;
+        writer->numBlocks++;
+    }
+
+    writer->buffer[writer->position] = byte;
+    writer->position++;
+
+    return (true);
+}
+
+bool D64_FileWriter_close(D64_FileWriter_t* const writer)
+{
+    if (!writer->isOpen)
+    {
+        return (false);
+    }
+
+    writer->isOpen = false;
+    bool isStored = false;
+
+    if (!writer->isFull)
+    {
+        /* last block holds the index of its last used byte instead of a link */
+        writer->buffer[D64_DIR_OFFSET_NEXT_TRACK] = 0;
+        writer->buffer[D64_DIR_OFFSET_NEXT_SECTOR] = (uint8_t) (writer->position - 1u);
+        D64_writeSector(writer->track, writer->sector, writer->buffer);
+
+        D64_DirEntry_t entry;
+        memcpy(entry.name, writer->name, D64_FIELD_SIZE_NAME);
+        entry.type = writer->type;
+        entry.track = writer->firstTrack;
+        entry.sector = writer->firstSector;
+        entry.blocks = writer->numBlocks;
+
+        isStored = D64_writeDirEntry(&entry);
+    }
+
+    if (!isStored)
+    {
+        D64_FileWriter_drop(writer);
+    }
+
+    D64_BAM_commit();
+    D64_buildDirIndex();
+    D64_invalidateListing();
+
+    return (isStored);
+}
+
+void D64_FileWriter_abandon(D64_FileWriter_t* const writer)
+{
+    if (!writer->isOpen)
+    {
+        return;
+    }
+
+    writer->isOpen = false;
+    D64_FileWriter_drop(writer);
+
+    D64_BAM_commit();
+    D64_invalidateListing();
+}
+
+static void D64_FileWriter_drop(D64_FileWriter_t* const writer)
+{
+    /* give back every block of the chain written so far */
+    uint8_t buf[D64_FIELD_SIZE_SECTOR];
+    uint8_t track = writer->firstTrack;
+    uint8_t sector = writer->firstSector;
+
+    for (uint16_t n = 0; n < writer->numBlocks; n++)
+    {
+        D64_BAM_free(track, sector);
+
+        if (((track == writer->track) && (sector == writer->sector)) || (!D64_readSector(track, sector, buf)))
+        {
+            break;
+        }
+
+        track = buf[D64_DIR_OFFSET_NEXT_TRACK];
+        sector = buf[D64_DIR_OFFSET_NEXT_SECTOR];
+    }
+}
+
+static uint16_t D64_File_getDataEnd(const uint8_t* const buf)
+{
+    /* on the last sector of a chain the sector byte holds the index of the last used byte */
+    if (0 != buf[D64_DIR_OFFSET_NEXT_TRACK])
+    {
+        return (D64_FIELD_SIZE_SECTOR);
+    }
+
+    if (buf[D64_DIR_OFFSET_NEXT_SECTOR] < D64_FILE_DATA_START)
+    {
+        return (D64_FILE_DATA_START);
+    }
+
+    return (buf[D64_DIR_OFFSET_NEXT_SECTOR] + 1u);
+}
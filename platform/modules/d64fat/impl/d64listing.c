@@ -0,0 +1,209 @@
+/*
+ * d64listing.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the listing is a tokenized basic program, as sent by the 1541 for LOAD"$",8 */
+#define D64_LISTING_LOAD_ADDRESS (0x0401u)
+#define D64_LISTING_LINE_SIZE    (32u)
+#define D64_LISTING_MAX_SIZE     (2u + ((D64_DIR_MAX_ENTRIES + 2u) * D64_LISTING_LINE_SIZE) + 2u)
+
+#define D64_LISTING_RVS_ON (0x12u)
+#define D64_LISTING_QUOTE  ('"')
+#define D64_LISTING_SPACE  (' ')
+
+#define D64_TYPE_CLOSED_MASK (0x80u)
+#define D64_TYPE_LOCKED_MASK (0x40u)
+#define D64_TYPE_FILE_MASK   (0x87u)
+
+static struct
+{
+    uint8_t data[D64_LISTING_MAX_SIZE];
+    size_t size;
+    bool isValid;
+} listing;
+
+static uint16_t generation; // bumped on every render, not part of the snapshot
+
+static const char* D64_getFiletype(const uint8_t byte); // convert filetype to easy interpretable string
+static size_t D64_beginLine(size_t pos, const uint16_t lineNumber);
+static size_t D64_endLine(size_t pos, const size_t lineStart);
+static size_t D64_putName(size_t pos, const uint8_t* const name);
+
+void D64_renderListing(void)
+{
+    const s64Data* const info = D64_getDiskInfo();
+
+    /* load address */
+    size_t pos = 0;
+    listing.data[pos++] = (uint8_t) (D64_LISTING_LOAD_ADDRESS & 0xff);
+    listing.data[pos++] = (uint8_t) (D64_LISTING_LOAD_ADDRESS >> 8);
+
+    /* header: 0 RVS"DISK NAME       " ID 2A */
+    size_t lineStart = pos;
+    pos = D64_beginLine(pos, 0);
+    listing.data[pos++] = D64_LISTING_RVS_ON;
+    listing.data[pos++] = D64_LISTING_QUOTE;
+    memcpy(&listing.data[pos], info->DiskName, D64_FIELD_SIZE_NAME);
+    pos += D64_FIELD_SIZE_NAME;
+    listing.data[pos++] = D64_LISTING_QUOTE;
+    listing.data[pos++] = D64_LISTING_SPACE;
+    listing.data[pos++] = info->DiskID[0];
+    listing.data[pos++] = info->DiskID[1];
+    listing.data[pos++] = D64_LISTING_SPACE;
+    listing.data[pos++] = info->DOSType[0];
+    listing.data[pos++] = info->DOSType[1];
+    pos = D64_endLine(pos, lineStart);
+
+    /* one line per file: blocks as line number, quoted name, type */
+    for (uint8_t i = 0; i < D64_getNumDirEntries(); i++)
+    {
+        const D64_DirEntry_t* const entry = D64_getDirEntry(i);
+
+        lineStart = pos;
+        pos = D64_beginLine(pos, entry->blocks);
+
+        /* line up the names like the drive does */
+        const uint8_t indent = (entry->blocks < 10u) ? 3u : (entry->blocks < 100u) ? 2u : (entry->blocks < 1000u) ? 1u : 0u;
+        for (uint8_t n = 0; n < indent; n++)
+        {
+            listing.data[pos++] = D64_LISTING_SPACE;
+        }
+
+        pos = D64_putName(pos, entry->name);
+        listing.data[pos++] = (entry->type & D64_TYPE_CLOSED_MASK) ? D64_LISTING_SPACE : '*';
+        memcpy(&listing.data[pos], D64_getFiletype(entry->type & D64_TYPE_FILE_MASK), 3);
+        pos += 3;
+        listing.data[pos++] = (entry->type & D64_TYPE_LOCKED_MASK) ? '<' : D64_LISTING_SPACE;
+        pos = D64_endLine(pos, lineStart);
+    }
+
+    /* footer */
+    lineStart = pos;
+    pos = D64_beginLine(pos, D64_BAM_getBlocksFree());
+    memcpy(&listing.data[pos], "BLOCKS FREE.", 12);
+    pos += 12;
+    pos = D64_endLine(pos, lineStart);
+
+    /* end of program */
+    listing.data[pos++] = 0;
+    listing.data[pos++] = 0;
+
+    listing.size = pos;
+    listing.isValid = true;
+    generation++;
+}
+
+void D64_invalidateListing(void)
+{
+    listing.isValid = false;
+}
+
+const uint8_t* D64_getListing(size_t* const size)
+{
+    if (!listing.isValid)
+    {
+        D64_renderListing();
+    }
+
+    *size = listing.size;
+    return (listing.data);
+}
+
+uint8_t* D64_borrowListing(size_t* const size)
+{
+    listing.isValid = false;
+
+    *size = sizeof(listing.data);
+    return (listing.data);
+}
+
+uint16_t D64_getListingGeneration(void)
+{
+    return (generation);
+}
+
+void* D64_getListingState(size_t* const size)
+{
+    *size = sizeof(listing);
+    return (&listing);
+}
+
+static size_t D64_beginLine(size_t pos, const uint16_t lineNumber)
+{
+    /* link is patched in D64_endLine() */
+    listing.data[pos++] = 0;
+    listing.data[pos++] = 0;
+    listing.data[pos++] = (uint8_t) (lineNumber & 0xff);
+    listing.data[pos++] = (uint8_t) (lineNumber >> 8);
+
+    return (pos);
+}
+
+static size_t D64_endLine(size_t pos, const size_t lineStart)
+{
+    /* pad every line to the same length, then terminate */
+    while (pos < (lineStart + D64_LISTING_LINE_SIZE - 1u))
+    {
+        listing.data[pos++] = D64_LISTING_SPACE;
+    }
+    listing.data[pos++] = 0;
+
+    /* link to next line, in c64 memory (load address is not part of the program) */
+    const uint16_t link = (uint16_t) (D64_LISTING_LOAD_ADDRESS + pos - 2u);
+    listing.data[lineStart] = (uint8_t) (link & 0xff);
+    listing.data[lineStart + 1u] = (uint8_t) (link >> 8);
+
+    return (pos);
+}
+
+static size_t D64_putName(size_t pos, const uint8_t* const name)
+{
+    uint8_t length = 0;
+    while ((length < D64_FIELD_SIZE_NAME) && (D64_NAME_PADDING != name[length]))
+    {
+        length++;
+    }
+
+    listing.data[pos++] = D64_LISTING_QUOTE;
+    memcpy(&listing.data[pos], name, length);
+    pos += length;
+    listing.data[pos++] = D64_LISTING_QUOTE;
+
+    /* keep the type column aligned */
+    for (uint8_t i = length; i < D64_FIELD_SIZE_NAME; i++)
+    {
+        listing.data[pos++] = D64_LISTING_SPACE;
+    }
+
+    return (pos);
+}
+
+static const char* D64_getFiletype(const uint8_t byte)
+{
+    /* this decodes bits to see what type there is */
+    /* returning *** means that the space is deleted */
+    switch (byte)
+    {
+        case 0:   return "***";
+        case 1:   return "SEQ";
+        case 2:   return "PRG";
+        case 3:   return "USR";
+        case 4:   return "REL";
+        case 128: return "DEL";
+        case 129: return "SEQ";
+        case 130: return "PRG";
+        case 131: return "USR";
+        case 132: return "REL";
+        default: return "---";
+    }
+}
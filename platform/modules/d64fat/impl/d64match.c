@@ -0,0 +1,259 @@
+/*
+ * d64match.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define D64_PATTERN_ANY   ('?')
+#define D64_PATTERN_REST  ('*')
+#define D64_PATTERN_DRIVE (':')
+#define D64_PATTERN_OPTS  (',')
+#define D64_PATTERN_DIR   ('$')
+
+static bool D64_isMatch(const D64_Pattern_t* const pattern, const uint8_t* const name);
+static bool D64_isDrivePrefix(const uint8_t* const name, const uint8_t position);
+static void D64_narrowCandidates(D64_NameMatch_t* const match, const uint8_t c);
+
+void D64_compilePattern(D64_Pattern_t* const pattern, const uint8_t* const name, const uint8_t length)
+{
+    uint8_t start = 0;
+    uint8_t end = 0;
+
+    /* skip a drive prefix like "0:" and stop at options like ",P,R" */
+    while ((end < length) && ('\0' != name[end]) && (D64_PATTERN_OPTS != name[end]))
+    {
+        if ((D64_PATTERN_DRIVE == name[end]) && D64_isDrivePrefix(name, end))
+        {
+            start = end + 1u;
+        }
+        end++;
+    }
+
+    memset(pattern->literal, D64_NAME_PADDING, D64_FIELD_SIZE_NAME);
+    pattern->anyMask = 0;
+    pattern->length = D64_FIELD_SIZE_NAME; // without a '*' the name has to end where the pattern ends
+    pattern->kind = D64_Pattern_Kind_Literal;
+
+    for (uint8_t i = 0; ((start + i) < end) && (i < D64_FIELD_SIZE_NAME); i++)
+    {
+        const uint8_t c = name[start + i];
+
+        if (D64_PATTERN_REST == c)
+        {
+            /* everything after the star is ignored */
+            pattern->length = i;
+            pattern->kind = (0 == i) ? D64_Pattern_Kind_First : D64_Pattern_Kind_Wildcard;
+            break;
+        }
+
+        if (D64_PATTERN_ANY == c)
+        {
+            pattern->anyMask |= (uint16_t) (1u << i);
+            pattern->kind = D64_Pattern_Kind_Wildcard;
+        }
+        else
+        {
+            pattern->literal[i] = c;
+        }
+    }
+}
+
+const D64_DirEntry_t* D64_matchPattern(const D64_Pattern_t* const pattern)
+{
+    switch (pattern->kind)
+    {
+        case D64_Pattern_Kind_Literal:
+            return (D64_findDirEntry(pattern->literal));
+
+        case D64_Pattern_Kind_First:
+            return (D64_getDirEntry(0));
+
+        default:
+            break;
+    }
+
+    for (uint8_t i = 0; i < D64_getNumDirEntries(); i++)
+    {
+        const D64_DirEntry_t* const entry = D64_getDirEntry(i);
+
+        if (D64_isMatch(pattern, entry->name))
+        {
+            return (entry);
+        }
+    }
+
+    return (NULL);
+}
+
+void D64_NameMatch_begin(D64_NameMatch_t* const match)
+{
+    match->length = 0;
+    match->position = 0;
+    match->lo = 0;
+    match->hi = D64_getNumDirEntries();
+    match->isNarrowing = true;
+    match->isDone = false;
+}
+
+void D64_NameMatch_feed(D64_NameMatch_t* const match, const uint8_t byte)
+{
+    if ((match->isDone) || (match->length >= sizeof(match->name)))
+    {
+        return;
+    }
+
+    match->name[match->length] = byte;
+    match->length++;
+
+    if (D64_PATTERN_OPTS == byte)
+    {
+        match->isDone = true;
+        return;
+    }
+
+    if ((D64_PATTERN_DRIVE == byte) && D64_isDrivePrefix(match->name, match->length - 1u))
+    {
+        /* that was the drive number, start over on the name itself */
+        const uint8_t length = match->length;
+        D64_NameMatch_begin(match);
+        match->length = length;
+        return;
+    }
+
+    if (match->position >= D64_FIELD_SIZE_NAME)
+    {
+        return;
+    }
+
+    if ((D64_PATTERN_ANY == byte) || (D64_PATTERN_REST == byte))
+    {
+        match->isNarrowing = false;
+    }
+
+    if (match->isNarrowing)
+    {
+        D64_narrowCandidates(match, byte);
+    }
+
+    match->position++;
+}
+
+C64_Load_Result_t D64_NameMatch_end(D64_NameMatch_t* const match, const D64_DirEntry_t** const entry)
+{
+    D64_Pattern_t pattern;
+    D64_compilePattern(&pattern, match->name, match->length);
+
+    *entry = NULL;
+
+    if ((D64_PATTERN_DIR == pattern.literal[0]) && (0 == (pattern.anyMask & 0x01u)))
+    {
+        return (C64_Load_Result_DirectoryReady);
+    }
+
+    switch (pattern.kind)
+    {
+        case D64_Pattern_Kind_Literal:
+            *entry = D64_findDirEntry(pattern.literal);
+            break;
+
+        case D64_Pattern_Kind_First:
+            *entry = D64_getDirEntry(0);
+            break;
+
+        default:
+        {
+            /* only the narrowed candidates can match, the drive picks the first in directory order */
+            uint8_t best = D64_DIR_MAX_ENTRIES;
+
+            for (uint8_t rank = match->lo; rank < match->hi; rank++)
+            {
+                const uint8_t index = D64_getSortedDirIndex(rank);
+
+                if ((index < best) && D64_isMatch(&pattern, D64_getDirEntry(index)->name))
+                {
+                    best = index;
+                }
+            }
+
+            *entry = D64_getDirEntry(best);
+            break;
+        }
+    }
+
+    return ((NULL != *entry) ? C64_Load_Result_LoadingReady : C64_Load_Result_FileNotFound);
+}
+
+static bool D64_isDrivePrefix(const uint8_t* const name, const uint8_t position)
+{
+    /* ":NAME" or "0:NAME" */
+    return ((0u == position) || ((1u == position) && ('0' <= name[0]) && ('9' >= name[0])));
+}
+
+static void D64_narrowCandidates(D64_NameMatch_t* const match, const uint8_t c)
+{
+    /* all candidates share the prefix so far, so they are sorted on this position too */
+    const uint8_t position = match->position;
+    uint8_t lo = match->lo;
+    uint8_t hi = match->hi;
+
+    while (lo < hi)
+    {
+        const uint8_t mid = lo + ((hi - lo) / 2u);
+        if (D64_getDirEntry(D64_getSortedDirIndex(mid))->name[position] < c)
+        {
+            lo = mid + 1u;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    const uint8_t first = lo;
+    hi = match->hi;
+
+    while (lo < hi)
+    {
+        const uint8_t mid = lo + ((hi - lo) / 2u);
+        if (D64_getDirEntry(D64_getSortedDirIndex(mid))->name[position] <= c)
+        {
+            lo = mid + 1u;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    match->lo = first;
+    match->hi = lo;
+}
+
+static bool D64_isMatch(const D64_Pattern_t* const pattern, const uint8_t* const name)
+{
+    for (uint8_t i = 0; i < pattern->length; i++)
+    {
+        if (pattern->anyMask & (1u << i))
+        {
+            /* '?' takes any character, but not the end of the name */
+            if (D64_NAME_PADDING == name[i])
+            {
+                return (false);
+            }
+        }
+        else if (pattern->literal[i] != name[i])
+        {
+            return (false);
+        }
+    }
+
+    return (true);
+}
@@ -12,207 +12,236 @@
 
 #include <stdint.h>         /* For uint8_t definition */
 #include <stdbool.h>        /* For true/false definition */
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-s64Data DiskInfo;
-dirEntry dEntry;
+/* free counts of the read only formats */
+#define D71_BAM_SIDE_TRACKS       (35)
+#define D71_BAM_OFFSET_SIDE2      (0xdd)
+#define D81_BAM_TRACKS_PER_SECTOR (40)
+#define D81_BAM_OFFSET_ENTRIES    (0x10)
+#define D81_BAM_ENTRY_SIZE        (6)
 
-uint32_t diskHeadPosition;
+/* the listing goes out a line at a time, the load address rides with the first */
+#define D64_TRANSFER_DIRECTORY_SLICE (32u)
 
-static const char* D64_getFiletype(const uint8_t byte); // convert filetype to easy interpretable string
+s64Data DiskInfo;
 
-void D64_initBAM(void)
-{
-    const uint32_t offset = D64_getSectorOffset(D64_FIELD_SIZE_DIR_TRACK-1);
+static uint8_t sectorBuffer[D64_FIELD_SIZE_SECTOR];
 
-    DiskInfo.DiskDOS = Flash_readByte(offset+2);
-    Flash_readBlock(offset+144, D64_FIELD_SIZE_NAME, DiskInfo.DiskName);
-    Flash_readBlock(offset+162,2,DiskInfo.DiskID);
-    Flash_readBlock(offset+164,2,DiskInfo.DOSType);
-}
+static uint16_t D64_countBlocksFree(const D64_Geometry_t* const geometry);
 
-void D64_printDirectory(void)
+void D64_mount(void)
 {
-    uint32_t offset = D64_getSectorOffset(D64_FIELD_SIZE_DIR_TRACK-1);
-    offset += D64_FIELD_SIZE_SECTOR; // directory starts after BAM sector
+    const uint32_t imageSize = Flash_getImageSize();
+    D64_selectGeometry(imageSize);
 
-    char sendString[33] = {'\0'};
+    /* a SAVE cut short by a power loss is finished before the image is looked at */
+    D64_Cache_recover();
 
-    while (1)
+    /* same image as last time, the parsed state is already in flash */
+    const uint32_t imageCrc = D64_Snapshot_fingerprint();
+    if (D64_Snapshot_load(imageSize, imageCrc))
     {
-        // each sector, excluding BAM
-        Flash_seek(offset, Flash_Mode_Read);
-        for (uint8_t k = 0; k < 8; k++ )
-        {
-            // move to sector block
-
-            if (0 == k)
-            {
-                dEntry.nextDirTrack = Flash_readByte(offset);
-                dEntry.nextDirSect = Flash_readByte(offset+1);
-            }
-
-            memcpy(dEntry.fType, D64_getFiletype(Flash_readByte(offset+2)), 3*sizeof(uint8_t));
-
-            dEntry.fTrack = Flash_readByte(offset+3);
-            dEntry.fSect = Flash_readByte(offset+4);
-
-            Flash_readBlock(offset+5,D64_FIELD_SIZE_NAME,dEntry.fName);
+        return;
+    }
 
-            dEntry.fBlocksL = Flash_readByte(offset+13);
-            dEntry.fBlocksH = Flash_readByte(offset+14);
-            dEntry.fBlocks = dEntry.fBlocksL + dEntry.fBlocksH*256;
+    D64_initBAM();
+    D64_buildDirIndex();
+    D64_renderListing();
 
-            // PRETTY PRINT
-            sprintf(sendString,"%5d  %20s  %3s",dEntry.fBlocks,dEntry.fName,dEntry.fType);
-            if (dEntry.fType[0] != '*')
-            {
-                // SEND TEXT STRING HERE
-                //sendIECBlock(sendString,32);
-            }
-            offset += D64_FIELD_SIZE_DIR_ENTRY;
-        }
-        if (0 == dEntry.nextDirTrack)
-        {
-            return;
-        }
-        else
-        {
-            offset = D64_getSectorOffset(dEntry.nextDirTrack - 1) + (D64_FIELD_SIZE_SECTOR * dEntry.nextDirSect);
-        }
-    }
-    //sendIECString("No disk loaded!");
+    D64_Snapshot_store(imageSize, imageCrc);
 }
 
-C64_Load_Result_t D64_uploadToC64(const uint8_t* const inName)
+void D64_initBAM(void)
 {
-    /* this function basically searches the disk for the filename */
-    /* a way to optimize this is to actually store start t/s for each filename */
-    /* in a separate struct on startup... this function only returns a flag to */
-    /* tell the looper if we are good to go or not */
+    const D64_Geometry_t* const geometry = D64_getGeometry();
 
-    if ('$' == inName[16])
+    if (!D64_readSector(geometry->dirTrack, geometry->headerSector, sectorBuffer))
     {
-        return (C64_Load_Result_DirectoryReady);
+        return;
     }
 
-    // we need to pad the input name with spaces
-    char NAME[17] = {'\0'};
-    sprintf(NAME,"%-16s",inName);
+    DiskInfo.DiskDOS = sectorBuffer[D64_BAM_OFFSET_DOS];
+    memcpy(DiskInfo.DiskName, &sectorBuffer[geometry->nameOffset], D64_FIELD_SIZE_NAME);
+    memcpy(DiskInfo.DiskID, &sectorBuffer[geometry->idOffset], 2);
+    memcpy(DiskInfo.DOSType, &sectorBuffer[geometry->dosTypeOffset], 2);
 
-    for (uint8_t i = 0; i < D64_FIELD_SIZE_NAME; i++)
+    if (geometry->isWritable)
     {
-        if (32 == NAME[i])
-        {
-            NAME[i] = 0xa0; // c64 padding
-        }
+        D64_BAM_load(sectorBuffer);
     }
-
-    uint32_t offset = D64_getSectorOffset(D64_FIELD_SIZE_DIR_TRACK-1);
-    offset += D64_FIELD_SIZE_SECTOR; // directory starts after BAM sector
-
-    while (1)
+    else
     {
-        for (uint8_t k = 0; k < 8; k++)
-        {
-            // move to sector block
-            Flash_seek(offset, Flash_Mode_Read);
+        D64_BAM_loadReadOnly(D64_countBlocksFree(geometry));
+    }
 
-            if (0 == k)
-            {
-                dEntry.nextDirTrack = Flash_readByte(offset);
-                dEntry.nextDirSect = Flash_readByte(offset+1);
-            }
+    D64_invalidateListing();
+}
 
-            memcpy(dEntry.fType, D64_getFiletype(Flash_readByte(offset+2)), 3*sizeof(uint8_t));
-            dEntry.fTrack = Flash_readByte(offset+3);
-            dEntry.fSect = Flash_readByte(offset+4);
-            Flash_readBlock(offset+5,D64_FIELD_SIZE_NAME,dEntry.fName);
+const s64Data* D64_getDiskInfo(void)
+{
+    return (&DiskInfo);
+}
 
-            if (0 == strncmp(NAME,(char*) dEntry.fName, strlen(NAME)))
-            {
-                // should really use strnIcmp (not found)
-                // name match like the line above
-                //flashSkipBytes(8);
+void* D64_getDiskInfoState(size_t* const size)
+{
+    *size = sizeof(DiskInfo);
+    return (&DiskInfo);
+}
 
-                dEntry.fBlocksL = Flash_readByte(offset+13);
-                dEntry.fBlocksH = Flash_readByte(offset+14);
-                dEntry.fBlocks = dEntry.fBlocksL + dEntry.fBlocksH*256;
+void D64_Transfer_beginDirectory(D64_Transfer_t* const transfer)
+{
+    /* the listing is rendered at mount, sending it is a straight copy to the bus */
+    transfer->data = D64_getListing(&transfer->remaining);
+    transfer->isDirectory = true;
+    transfer->isOpen = true;
+    transfer->isStarted = false;
+    transfer->isSending = false;
+    transfer->isLast = false;
+}
 
-                /* file found */
-                offset = D64_getSectorOffset(dEntry.fTrack - 1) + (D64_FIELD_SIZE_SECTOR * dEntry.fSect);
-                diskHeadPosition = offset;
+bool D64_Transfer_beginProgram(D64_Transfer_t* const transfer, const uint8_t track, const uint8_t sector)
+{
+    transfer->data = NULL;
+    transfer->remaining = 0;
+    transfer->isDirectory = false;
+    transfer->isOpen = D64_File_open(&transfer->file, track, sector);
+    transfer->isStarted = false;
+    transfer->isSending = false;
+    transfer->isLast = false;
+
+    return (transfer->isOpen);
+}
 
-                Flash_seek(offset, Flash_Mode_Read);
-                return (C64_Load_Result_LoadingReady);
-            }
+D64_Transfer_Result_t D64_Transfer_step(D64_Transfer_t* const transfer)
+{
+    if (!transfer->isOpen)
+    {
+        return (D64_Transfer_Result_Aborted);
+    }
 
-            offset += D64_FIELD_SIZE_DIR_ENTRY;
+    /* the slice on the bus has to be acknowledged before the next one */
+    if (transfer->isSending)
+    {
+        const IEC_Result_t result = IEC_getBlockResult();
+
+        if (IEC_Result_Busy == result)
+        {
+            return (D64_Transfer_Result_Busy);
         }
 
-        if (0 == dEntry.nextDirTrack)
+        transfer->isSending = false;
+
+        if (IEC_Result_Ok != result)
         {
-            break;
+            return (D64_Transfer_Result_Aborted);
         }
-        else
+
+        if (transfer->isLast)
         {
-            offset = D64_getSectorOffset(dEntry.nextDirTrack - 1) + (D64_FIELD_SIZE_SECTOR * dEntry.nextDirSect);
+            return (D64_Transfer_Result_Done);
         }
     }
 
-    return (C64_Load_Result_FileNotFound);
-}
-
-void D64_readProgramBinary(const uint8_t fTrack, const uint8_t fSect)
-{
-    uint32_t offset = D64_getSectorOffset(fTrack-1) + (D64_FIELD_SIZE_SECTOR * fSect);
+    /* before the first slice the host may still be turning the bus around */
+    if (!IEC_isTalking())
+    {
+        return (transfer->isStarted ? D64_Transfer_Result_Aborted : D64_Transfer_Result_Busy);
+    }
 
-    uint8_t nextDirTrack = 0;
-    uint8_t nextDirSect = 0;
+    const uint8_t* data = NULL;
+    size_t length = 0;
 
-    while (1)
+    if (transfer->isDirectory)
     {
-        // move to sector block
-        Flash_seek(offset, Flash_Mode_Read);
-        nextDirTrack = Flash_readByte(offset);
-        nextDirSect = Flash_readByte(offset+1);
-
-        /* is it best to buffer the array, or bit bang after each read? */
-        /* we need to calculate the speed of read from flash */
+        length = (transfer->remaining > D64_TRANSFER_DIRECTORY_SLICE) ? D64_TRANSFER_DIRECTORY_SLICE : transfer->remaining;
+        data = transfer->data;
+        transfer->data += length;
+        transfer->remaining -= length;
+        transfer->isLast = (0 == transfer->remaining);
+    }
+    else
+    {
+        /* one sector payload per slice, sent from the file buffer without a copy */
+        uint16_t blockLength = 0;
+        if (!D64_File_readBlock(&transfer->file, &data, &blockLength, &transfer->isLast))
+        {
+            return (D64_Transfer_Result_Aborted);
+        }
+        length = blockLength;
+    }
 
-        //eeReadBlock(BLOCK_SIZE,DATABLOCK);
+    if (IEC_Result_Ok != IEC_sendBlock(data, length, transfer->isLast))
+    {
+        return (D64_Transfer_Result_Aborted); // ATN came in between
+    }
 
-        /* check 'end' conditions, should be implemented in sendIECBlock or here? */
+    transfer->isStarted = true;
+    transfer->isSending = true;
 
-        //sendIECBlock(DATABLOCK,BLOCK_SIZE);
+    /* next sector is pulled into the other buffer while this one is on the bus */
+    if (!transfer->isDirectory)
+    {
+        D64_File_prefetch(&transfer->file);
+    }
 
-        if (0 == nextDirTrack)
-        {
-            return;
-        }
+    return (D64_Transfer_Result_Busy);
+}
 
-        offset = D64_getSectorOffset(nextDirTrack - 1) + (D64_FIELD_SIZE_SECTOR * nextDirSect);
+void D64_Transfer_end(D64_Transfer_t* const transfer)
+{
+    if (transfer->isOpen && (!transfer->isDirectory))
+    {
+        D64_File_close(&transfer->file);
     }
+
+    transfer->isOpen = false;
+    transfer->isSending = false;
 }
 
-static const char* D64_getFiletype(const uint8_t byte)
+static uint16_t D64_countBlocksFree(const D64_Geometry_t* const geometry)
 {
-    /* this decodes bits to see what type there is */
-    /* returning *** means that the space is deleted */
-    switch (byte)
+    /* only the free counts are summed, for the listing footer */
+    uint16_t blocksFree = 0;
+
+    switch (geometry->format)
     {
-        case 0:   return "***";
-        case 1:   return "SEQ";
-        case 2:   return "PRG";
-        case 3:   return "USR";
-        case 4:   return "REL";
-        case 128: return "DEL";
-        case 129: return "SEQ";
-        case 130: return "PRG";
-        case 131: return "USR";
-        case 132: return "REL";
-        default: return "---";
+        case D64_Format_D71:
+            /* side one as on a d64 (header sector is loaded), side two counts at 0xdd */
+            for (uint8_t track = 1; track <= D71_BAM_SIDE_TRACKS; track++)
+            {
+                /* skips the directory track and its twin on side two */
+                if (geometry->dirTrack != track)
+                {
+                    blocksFree += sectorBuffer[D64_BAM_OFFSET_ENTRIES + (D64_BAM_ENTRY_SIZE * (track - 1))];
+                    blocksFree += sectorBuffer[D71_BAM_OFFSET_SIDE2 + (track - 1)];
+                }
+            }
+            break;
+
+        case D64_Format_D81:
+            /* two BAM sectors after the header, 40 tracks each */
+            for (uint8_t n = 0; n < 2; n++)
+            {
+                if (!D64_readSector(geometry->dirTrack, geometry->headerSector + 1u + n, sectorBuffer))
+                {
+                    break;
+                }
+
+                for (uint8_t k = 0; k < D81_BAM_TRACKS_PER_SECTOR; k++)
+                {
+                    if (geometry->dirTrack != ((n * D81_BAM_TRACKS_PER_SECTOR) + k + 1u))
+                    {
+                        blocksFree += sectorBuffer[D81_BAM_OFFSET_ENTRIES + (D81_BAM_ENTRY_SIZE * k)];
+                    }
+                }
+            }
+            break;
+
+        default:
+            break;
     }
+
+    return (blocksFree);
 }
@@ -6,40 +6,156 @@
  */
 
 #include "d64Iface.h"
+
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
 
-#define D64_NUM_TRACKS (40)
+/* sectors per track in the four 1541 speed zones, i is the 0-based track */
+#define D64_ZONE_SECTORS(i) (((i) < 17) ? 21u : ((i) < 24) ? 19u : ((i) < 30) ? 18u : 17u)
 
-/* number of sectors for each track */
-static const uint8_t d64sectors[D64_NUM_TRACKS] = {
-    21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 19, 19, 19,
-    19, 19, 19, 19, 18, 18, 18, 18, 18, 18, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17
-};
+/* sectors ahead of track i, zones start at 17 * 21, + 7 * 19, + 6 * 18 */
+#define D64_ZONE_START(i) (((i) < 17) ? ((i) * 21u) \
+                         : ((i) < 24) ? (357u + (((i) - 17u) * 19u)) \
+                         : ((i) < 30) ? (490u + (((i) - 24u) * 18u)) \
+                         :              (598u + (((i) - 30u) * 17u)))
+
+/* the 1571 puts a second 35 track 1541 side after the first */
+#define D71_SIDE_TRACKS      (35u)
+#define D71_SIDE_SECTORS     (683u)
+#define D71_SECTORS(i)       D64_ZONE_SECTORS((i) % D71_SIDE_TRACKS)
+#define D71_START(i)         (((i) < D71_SIDE_TRACKS) ? D64_ZONE_START(i) : (D71_SIDE_SECTORS + D64_ZONE_START((i) - D71_SIDE_TRACKS)))
+
+/* the 1581 has no zones */
+#define D81_SECTORS(i)       (40u)
+#define D81_START(i)         ((i) * 40u)
+
+#define D64_OFFSET(start)    ((uint32_t) (start) * D64_FIELD_SIZE_SECTOR)
+#define D64_ZONE_OFFSET(i)   D64_OFFSET(D64_ZONE_START(i))
+#define D71_OFFSET(i)        D64_OFFSET(D71_START(i))
+#define D81_OFFSET(i)        D64_OFFSET(D81_START(i))
+
+/* table generators, m(i) is expanded for every track index */
+#define D64_TRACKS_10(m, b)  m((b) + 0u), m((b) + 1u), m((b) + 2u), m((b) + 3u), m((b) + 4u), \
+                             m((b) + 5u), m((b) + 6u), m((b) + 7u), m((b) + 8u), m((b) + 9u)
+#define D64_TRACKS_40(m, b)  D64_TRACKS_10(m, (b)), D64_TRACKS_10(m, (b) + 10u), \
+                             D64_TRACKS_10(m, (b) + 20u), D64_TRACKS_10(m, (b) + 30u)
+#define D64_TRACKS_42(m)     D64_TRACKS_40(m, 0u), m(40u), m(41u)
+#define D64_TRACKS_70(m)     D64_TRACKS_40(m, 0u), D64_TRACKS_10(m, 40u), D64_TRACKS_10(m, 50u), D64_TRACKS_10(m, 60u)
+#define D64_TRACKS_80(m)     D64_TRACKS_40(m, 0u), D64_TRACKS_40(m, 40u)
+
+/* 35 and 40 track images are the first part of the 42 track layout */
+static const uint8_t d64sectors[42] = { D64_TRACKS_42(D64_ZONE_SECTORS) };
+static const uint32_t d64offsets[42] = { D64_TRACKS_42(D64_ZONE_OFFSET) };
+static const uint8_t d71sectors[70] = { D64_TRACKS_70(D71_SECTORS) };
+static const uint32_t d71offsets[70] = { D64_TRACKS_70(D71_OFFSET) };
+static const uint8_t d81sectors[80] = { D64_TRACKS_80(D81_SECTORS) };
+static const uint32_t d81offsets[80] = { D64_TRACKS_80(D81_OFFSET) };
+
+#define D64_GEOMETRY_1541(tracks, fmt, writable) { \
+    .numSectors = d64sectors, .offsets = d64offsets, .numTracks = (tracks), \
+    .dirTrack = 18, .headerSector = 0, .dirSector = 1, \
+    .nameOffset = 0x90, .idOffset = 0xa2, .dosTypeOffset = 0xa5, \
+    .isWritable = (writable), .format = (fmt) }
+
+static const D64_Geometry_t d64Geometry35 = D64_GEOMETRY_1541(35, D64_Format_D64, true);
+static const D64_Geometry_t d64Geometry40 = D64_GEOMETRY_1541(40, D64_Format_D64, true);
+static const D64_Geometry_t d64Geometry42 = D64_GEOMETRY_1541(42, D64_Format_D64, true);
+
+static const D64_Geometry_t d71Geometry = {
+    .numSectors = d71sectors, .offsets = d71offsets, .numTracks = 70,
+    .dirTrack = 18, .headerSector = 0, .dirSector = 1,
+    .nameOffset = 0x90, .idOffset = 0xa2, .dosTypeOffset = 0xa5,
+    .isWritable = false, .format = D64_Format_D71 };
 
-/* byte offset for first sector in each track */
-static const uint32_t d64offsets[D64_NUM_TRACKS] = {
-         0,   5376,  10752,  16128,  21504,  26880,  32256,  37632,  43008,  48384,
-     53760,  59136,  64512,  69888,  75264,  80640,  86016,  91392,  96256, 101120,
-    105984, 110848, 115712, 120576, 125440, 130048, 134656, 139264, 143872, 148480,
-    153088, 157440, 161792, 166144, 170496, 174848, 179200, 183552, 187904, 192256
+static const D64_Geometry_t d81Geometry = {
+    .numSectors = d81sectors, .offsets = d81offsets, .numTracks = 80,
+    .dirTrack = 40, .headerSector = 0, .dirSector = 3,
+    .nameOffset = 0x04, .idOffset = 0x16, .dosTypeOffset = 0x19,
+    .isWritable = false, .format = D64_Format_D81 };
+
+/* images are recognized by size, with or without one error byte per sector */
+static const struct
+{
+    uint32_t size;
+    const D64_Geometry_t* geometry;
+} d64ImageSizes[] = {
+    { 174848u, &d64Geometry35 }, { 175531u, &d64Geometry35 },
+    { 196608u, &d64Geometry40 }, { 197376u, &d64Geometry40 },
+    { 205312u, &d64Geometry42 }, { 206114u, &d64Geometry42 },
+    { 349696u, &d71Geometry   }, { 351062u, &d71Geometry   },
+    { 819200u, &d81Geometry   }, { 822400u, &d81Geometry   },
 };
 
-uint8_t D64_getSectorLength(const uint8_t track)
+static const D64_Geometry_t* geometry = &d64Geometry35;
+
+bool D64_selectGeometry(const uint32_t imageSize)
 {
-    if (track < D64_NUM_TRACKS)
+    for (uint8_t i = 0; i < (sizeof(d64ImageSizes) / sizeof(d64ImageSizes[0])); i++)
     {
-        return (d64sectors[track]);
+        if (imageSize == d64ImageSizes[i].size)
+        {
+            geometry = d64ImageSizes[i].geometry;
+            return (true);
+        }
     }
 
-    return (0);
+    /* unknown size, treat it as a plain 35 track image */
+    geometry = &d64Geometry35;
+    return (false);
 }
 
-uint32_t D64_getSectorOffset(const uint8_t track)
+const D64_Geometry_t* D64_getGeometry(void)
 {
-    if (track < D64_NUM_TRACKS)
+    return (geometry);
+}
+
+uint8_t D64_getNumSectors(const uint8_t track)
+{
+    /* track 0 wraps around and fails the range check */
+    const uint8_t index = track - 1u;
+
+    return ((index < geometry->numTracks) ? geometry->numSectors[index] : 0u);
+}
+
+bool D64_getSectorAddress(const uint8_t track, const uint8_t sector, uint32_t* const offset)
+{
+    const uint8_t index = track - 1u;
+
+    if ((index >= geometry->numTracks) || (sector >= geometry->numSectors[index]))
+    {
+        return (false);
+    }
+
+    *offset = geometry->offsets[index] + ((uint32_t) sector * D64_FIELD_SIZE_SECTOR);
+
+    return (true);
+}
+
+bool D64_readSector(const uint8_t track, const uint8_t sector, uint8_t* const buf)
+{
+    uint32_t offset;
+
+    if (!D64_getSectorAddress(track, sector, &offset))
     {
-        return (d64offsets[track]);
+        return (false);
     }
 
-    return (0);
+    /* one transaction for the whole sector, unless it is still waiting in the write cache */
+    return (D64_Cache_readSector(offset, buf));
+}
+
+bool D64_writeSector(const uint8_t track, const uint8_t sector, const uint8_t* const buf)
+{
+    uint32_t offset;
+
+    if ((!geometry->isWritable) || (!D64_getSectorAddress(track, sector, &offset)))
+    {
+        return (false);
+    }
+
+    /* the BAM and directory are rewritten all through a SAVE, they wait in ram */
+    D64_Cache_writeSector(offset, buf, (track == geometry->dirTrack));
+
+    return (true);
 }
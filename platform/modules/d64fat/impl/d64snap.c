@@ -0,0 +1,187 @@
+/*
+ * d64snap.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "d64Iface.h"
+
+#include "flashIface.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the parsed state of the last mounted image is kept in a reserved flash */
+/* area, so a reboot with the same image only has to check the fingerprint */
+#define D64_SNAPSHOT_MAGIC   (0x44363453uL) // "D64S"
+#define D64_SNAPSHOT_VERSION (1u)           // bump when a saved struct changes meaning
+#define D64_SNAPSHOT_DATA    (FLASH_SNAPSHOT_ADDRESS + sizeof(D64_Snapshot_Header_t))
+
+/* the directory chain can never be longer than the directory track */
+#define D64_SNAPSHOT_MAX_SECTORS (40u)
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numSections;
+    uint32_t imageSize;
+    uint32_t imageCrc;
+    uint32_t dataSize;
+    uint32_t dataCrc;
+} D64_Snapshot_Header_t;
+
+typedef struct
+{
+    void* data;
+    size_t size;
+} D64_Snapshot_Section_t;
+
+#define D64_SNAPSHOT_NUM_SECTIONS (4u)
+
+static uint32_t D64_Snapshot_getSections(D64_Snapshot_Section_t* const sections);
+
+uint32_t D64_Snapshot_fingerprint(void)
+{
+    const D64_Geometry_t* const geometry = D64_getGeometry();
+    uint8_t buf[D64_FIELD_SIZE_SECTOR];
+    uint32_t crc = 0xffffffffuL;
+
+    /* header and BAM sectors, they sit in front of the directory on every format */
+    for (uint8_t sector = geometry->headerSector; sector < geometry->dirSector; sector++)
+    {
+        if (D64_readSector(geometry->dirTrack, sector, buf))
+        {
+            crc = D64_crc32(crc, buf, sizeof(buf));
+        }
+    }
+
+    /* directory chain */
+    uint8_t track = geometry->dirTrack;
+    uint8_t sector = geometry->dirSector;
+
+    for (uint8_t n = 0; (n < D64_SNAPSHOT_MAX_SECTORS) && (0 != track); n++)
+    {
+        if (!D64_readSector(track, sector, buf))
+        {
+            break;
+        }
+
+        crc = D64_crc32(crc, buf, sizeof(buf));
+
+        track = buf[D64_DIR_OFFSET_NEXT_TRACK];
+        sector = buf[D64_DIR_OFFSET_NEXT_SECTOR];
+    }
+
+    return (~crc);
+}
+
+bool D64_Snapshot_load(const uint32_t imageSize, const uint32_t imageCrc)
+{
+    D64_Snapshot_Header_t header;
+    D64_Snapshot_Section_t sections[D64_SNAPSHOT_NUM_SECTIONS];
+    const uint32_t dataSize = D64_Snapshot_getSections(sections);
+
+    Flash_readBlock(FLASH_SNAPSHOT_ADDRESS, sizeof(header), (uint8_t*) &header);
+
+    /* the sizes also catch firmware builds with differently laid out state */
+    if ((D64_SNAPSHOT_MAGIC != header.magic)
+        || (D64_SNAPSHOT_VERSION != header.version)
+        || (D64_SNAPSHOT_NUM_SECTIONS != header.numSections)
+        || (imageSize != header.imageSize)
+        || (imageCrc != header.imageCrc)
+        || (dataSize != header.dataSize))
+    {
+        return (false);
+    }
+
+    /* straight into the module state, a bad crc leaves it for the full scan to overwrite */
+    uint32_t address = D64_SNAPSHOT_DATA;
+    uint32_t crc = 0xffffffffuL;
+
+    for (uint8_t i = 0; i < D64_SNAPSHOT_NUM_SECTIONS; i++)
+    {
+        Flash_readBlock(address, sections[i].size, sections[i].data);
+        crc = D64_crc32(crc, sections[i].data, sections[i].size);
+        address += sections[i].size;
+    }
+
+    return (header.dataCrc == ~crc);
+}
+
+void D64_Snapshot_store(const uint32_t imageSize, const uint32_t imageCrc)
+{
+    D64_Snapshot_Header_t header;
+    D64_Snapshot_Section_t sections[D64_SNAPSHOT_NUM_SECTIONS];
+    const uint32_t dataSize = D64_Snapshot_getSections(sections);
+
+    if ((sizeof(header) + dataSize) > FLASH_SNAPSHOT_SIZE)
+    {
+        return;
+    }
+
+    for (uint32_t offset = 0; offset < (sizeof(header) + dataSize); offset += FLASH_ERASE_BLOCK_SIZE)
+    {
+        Flash_eraseBlock(FLASH_SNAPSHOT_ADDRESS + offset);
+    }
+
+    uint32_t address = D64_SNAPSHOT_DATA;
+    uint32_t crc = 0xffffffffuL;
+
+    for (uint8_t i = 0; i < D64_SNAPSHOT_NUM_SECTIONS; i++)
+    {
+        Flash_writeBlock(address, sections[i].size, sections[i].data);
+        crc = D64_crc32(crc, sections[i].data, sections[i].size);
+        address += sections[i].size;
+    }
+
+    /* header goes last, an interrupted store is never taken for valid */
+    header.magic = D64_SNAPSHOT_MAGIC;
+    header.version = D64_SNAPSHOT_VERSION;
+    header.numSections = D64_SNAPSHOT_NUM_SECTIONS;
+    header.imageSize = imageSize;
+    header.imageCrc = imageCrc;
+    header.dataSize = dataSize;
+    header.dataCrc = ~crc;
+
+    Flash_writeBlock(FLASH_SNAPSHOT_ADDRESS, sizeof(header), (const uint8_t*) &header);
+}
+
+static uint32_t D64_Snapshot_getSections(D64_Snapshot_Section_t* const sections)
+{
+    sections[0].data = D64_getDiskInfoState(&sections[0].size);
+    sections[1].data = D64_getDirIndexState(&sections[1].size);
+    sections[2].data = D64_BAM_getState(&sections[2].size);
+    sections[3].data = D64_getListingState(&sections[3].size);
+
+    uint32_t dataSize = 0;
+    for (uint8_t i = 0; i < D64_SNAPSHOT_NUM_SECTIONS; i++)
+    {
+        dataSize += sections[i].size;
+    }
+
+    return (dataSize);
+}
+
+uint32_t D64_crc32(uint32_t crc, const uint8_t* const data, const size_t size)
+{
+    /* reflected crc-32, a nibble at a time keeps the table small */
+    static const uint32_t table[16] = {
+        0x00000000uL, 0x1db71064uL, 0x3b6e20c8uL, 0x26d930acuL,
+        0x76dc4190uL, 0x6b6b51f4uL, 0x4db26158uL, 0x5005713cuL,
+        0xedb88320uL, 0xf00f9344uL, 0xd6d6a3e8uL, 0xcb61b38cuL,
+        0x9b64c2b0uL, 0x86d3d2d4uL, 0xa00ae278uL, 0xbdbdf21cuL,
+    };
+
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+    }
+
+    return (crc);
+}
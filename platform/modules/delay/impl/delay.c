@@ -9,13 +9,70 @@
 
 #include <stdint.h>
 
-void Delay_us(const uint32_t time_us)
+#ifndef WIN32
+#include "mcu.h"
+#include "kexx_delay.h"
+#include "kexx_timer.h"
+#endif
+
+/* Delay_ticks() counts by 3 in a 4 cycle loop (add, cmp and a taken blt) */
+#define DELAY_CORRECTION_SHIFT   (12u)
+#define DELAY_CORRECTION_NOMINAL ((3u << DELAY_CORRECTION_SHIFT) / 4u) // loop counts per cycle, q12
+
+/* call, return and the scaling below, measured off a disassembly */
+#define DELAY_OVERHEAD_CYCLES (20u)
+
+/* about 1.5 ms at 20.97 MHz, long enough to hide the two counter reads */
+#define DELAY_CALIBRATION_COUNTS (24000u)
+
+static struct
+{
+    uint32_t correction; // q12, loop counts per core cycle
+} delay = {
+    .correction = DELAY_CORRECTION_NOMINAL,
+};
+
+void Delay_cycles(const uint32_t cycles)
 {
+    if (cycles <= DELAY_OVERHEAD_CYCLES)
+    {
+        return;
+    }
 
+    /* q12 keeps this a single 32-bit multiply for anything up to ~1 M cycles */
+    const uint32_t ticks = ((cycles - DELAY_OVERHEAD_CYCLES) * delay.correction) >> DELAY_CORRECTION_SHIFT;
+#ifndef WIN32
+    Delay_ticks(ticks);
+#else
+    (void) ticks;
+#endif
 }
 
-void Delay_ns(const uint32_t time_ns)
+void Delay_calibrate(void)
 {
+#ifndef WIN32
+    /* the PIT channel PeriodicTimer_wait() uses, free running without interrupt */
+    static const PeriodicTimer_t reference = {
+        .callback = NULL,
+        .channel = 1,
+    };
 
-}
+    PeriodicTimer_enableGlobal();
+    PeriodicTimer_start(&reference, 0xffffffffuL);
+
+    const uint32_t begin = PeriodicTimer_getCount(&reference);
+    Delay_ticks(DELAY_CALIBRATION_COUNTS);
+    const uint32_t end = PeriodicTimer_getCount(&reference);
+
+    PeriodicTimer_disable(&reference);
 
+    /* the PIT runs on the bus clock, half the core clock, and counts down */
+    const uint32_t busTicks = begin - end;
+    const uint32_t cycles = (busTicks * 2u * (DELAY_CORE_CLOCK_HZ / 1000u)) / (SystemCoreClock / 1000u);
+
+    if (0 != cycles)
+    {
+        delay.correction = (DELAY_CALIBRATION_COUNTS << DELAY_CORRECTION_SHIFT) / cycles;
+    }
+#endif
+}
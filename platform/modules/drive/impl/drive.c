@@ -0,0 +1,990 @@
+/*
+ * drive.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Jiisuki
+ */
+
+#include "driveIface.h"
+
+#include "d64Iface.h"
+#include "iecIface.h"
+#include "iecPins.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <time.h>
+#endif
+
+/* 1541 memory map, anything else reads as open bus */
+#define DRIVE_RAM_MASK   (DRIVE_RAM_SIZE - 1u) // the 2 KB repeat up to the first VIA
+#define DRIVE_VIA1_BASE  (0x1800u) // serial bus
+#define DRIVE_VIA2_BASE  (0x1c00u) // disk controller, stubs only
+#define DRIVE_VIA_AREA   (0xfc00u) // registers repeat through the area
+#define DRIVE_VIA_REG    (0x000fu)
+#define DRIVE_ROM_BASE   (0xc000u) // no dos rom, see Drive_enterRom()
+#define DRIVE_STACK_BASE (0x0100u)
+
+/* job queue, one job byte and a track/sector pair per buffer at $0300 */
+#define DRIVE_NUM_JOBS      (5u)
+#define DRIVE_JOB_HEADERS   (0x0006u)
+#define DRIVE_JOB_BUFFERS   (0x0300u)
+#define DRIVE_JOB_READ      (0x80u)
+#define DRIVE_JOB_WRITE     (0x90u)
+#define DRIVE_JOB_JUMP      (0xd0u)
+#define DRIVE_JOB_EXECUTE   (0xe0u)
+#define DRIVE_JOB_OK        (0x01u)
+#define DRIVE_JOB_NO_HEADER (0x02u)
+#define DRIVE_JOB_PROTECTED (0x08u)
+
+/* VIA registers */
+#define DRIVE_VIA_ORB  (0x0u)
+#define DRIVE_VIA_DDRB (0x2u)
+#define DRIVE_VIA_T1CL (0x4u)
+#define DRIVE_VIA_T1CH (0x5u)
+#define DRIVE_VIA_T1LL (0x6u)
+#define DRIVE_VIA_T1LH (0x7u)
+#define DRIVE_VIA_IFR  (0xdu)
+#define DRIVE_VIA_IFR_T1 (0x40u)
+
+/* VIA1 port B, the inputs read as one while the line is pulled */
+#define DRIVE_PORT_DATA_IN  (0x01u)
+#define DRIVE_PORT_DATA_OUT (0x02u)
+#define DRIVE_PORT_CLK_IN   (0x04u)
+#define DRIVE_PORT_CLK_OUT  (0x08u)
+#define DRIVE_PORT_ATNA     (0x10u)
+#define DRIVE_PORT_ATN_IN   (0x80u)
+#define DRIVE_PORT_DDR      (0x1au) // as left by the dos, device 8 reads zero on bits 5-6
+
+/* status register */
+#define DRIVE_FLAG_C (0x01u)
+#define DRIVE_FLAG_Z (0x02u)
+#define DRIVE_FLAG_I (0x04u)
+#define DRIVE_FLAG_D (0x08u)
+#define DRIVE_FLAG_B (0x10u)
+#define DRIVE_FLAG_U (0x20u)
+#define DRIVE_FLAG_V (0x40u)
+#define DRIVE_FLAG_N (0x80u)
+
+/* there is no reset line, drive code that stops looking at the bus is ended */
+#define DRIVE_ATN_IDLE_CYCLES (20000u)   // host is holding ATN, 20 ms without the port read
+#define DRIVE_IDLE_CYCLES     (2000000u) // two seconds without touching the port at all
+
+#define DRIVE_OPCODE_RTS   (0x60u)
+#define DRIVE_PAGE_PENALTY (0x80u) // one more cycle when the index crosses a page
+#define DRIVE_CYCLES_MASK  (0x0fu)
+
+typedef enum
+{
+    Drive_Mode_Imp,
+    Drive_Mode_Acc,
+    Drive_Mode_Imm,
+    Drive_Mode_Zp,
+    Drive_Mode_Zpx,
+    Drive_Mode_Zpy,
+    Drive_Mode_Abs,
+    Drive_Mode_Abx,
+    Drive_Mode_Aby,
+    Drive_Mode_Ind,
+    Drive_Mode_Izx,
+    Drive_Mode_Izy,
+    Drive_Mode_Rel,
+} Drive_Mode_t;
+
+typedef enum
+{
+    Drive_Op_Adc, Drive_Op_And, Drive_Op_Asl, Drive_Op_Bcc, Drive_Op_Bcs, Drive_Op_Beq, Drive_Op_Bit, Drive_Op_Bmi,
+    Drive_Op_Bne, Drive_Op_Bpl, Drive_Op_Brk, Drive_Op_Bvc, Drive_Op_Bvs, Drive_Op_Clc, Drive_Op_Cld, Drive_Op_Cli,
+    Drive_Op_Clv, Drive_Op_Cmp, Drive_Op_Cpx, Drive_Op_Cpy, Drive_Op_Dec, Drive_Op_Dex, Drive_Op_Dey, Drive_Op_Eor,
+    Drive_Op_Inc, Drive_Op_Inx, Drive_Op_Iny, Drive_Op_Jmp, Drive_Op_Jsr, Drive_Op_Lda, Drive_Op_Ldx, Drive_Op_Ldy,
+    Drive_Op_Lsr, Drive_Op_Nop, Drive_Op_Ora, Drive_Op_Pha, Drive_Op_Php, Drive_Op_Pla, Drive_Op_Plp, Drive_Op_Rol,
+    Drive_Op_Ror, Drive_Op_Rti, Drive_Op_Rts, Drive_Op_Sbc, Drive_Op_Sec, Drive_Op_Sed, Drive_Op_Sei, Drive_Op_Sta,
+    Drive_Op_Stx, Drive_Op_Sty, Drive_Op_Tax, Drive_Op_Tay, Drive_Op_Tsx, Drive_Op_Txa, Drive_Op_Txs, Drive_Op_Tya,
+    Drive_Op_Jam, // illegal opcodes stop the cpu
+} Drive_Op_t;
+
+typedef struct
+{
+    uint8_t op;     // Drive_Op_t
+    uint8_t mode;   // Drive_Mode_t
+    uint8_t cycles; // base cycles, DRIVE_PAGE_PENALTY for indexed reads
+} Drive_Opcode_t;
+
+/* decoded once per opcode, kept in flash */
+static const Drive_Opcode_t opcodes[256] = {
+    /* 00 */ { Drive_Op_Brk, Drive_Mode_Imp, 7 }, /* 01 */ { Drive_Op_Ora, Drive_Mode_Izx, 6 }, /* 02 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 03 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 04 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 05 */ { Drive_Op_Ora, Drive_Mode_Zp, 3 }, /* 06 */ { Drive_Op_Asl, Drive_Mode_Zp, 5 }, /* 07 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 08 */ { Drive_Op_Php, Drive_Mode_Imp, 3 }, /* 09 */ { Drive_Op_Ora, Drive_Mode_Imm, 2 }, /* 0a */ { Drive_Op_Asl, Drive_Mode_Acc, 2 }, /* 0b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 0c */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 0d */ { Drive_Op_Ora, Drive_Mode_Abs, 4 }, /* 0e */ { Drive_Op_Asl, Drive_Mode_Abs, 6 }, /* 0f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 10 */ { Drive_Op_Bpl, Drive_Mode_Rel, 2 }, /* 11 */ { Drive_Op_Ora, Drive_Mode_Izy, 5 | DRIVE_PAGE_PENALTY }, /* 12 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 13 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 14 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 15 */ { Drive_Op_Ora, Drive_Mode_Zpx, 4 }, /* 16 */ { Drive_Op_Asl, Drive_Mode_Zpx, 6 }, /* 17 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 18 */ { Drive_Op_Clc, Drive_Mode_Imp, 2 }, /* 19 */ { Drive_Op_Ora, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* 1a */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 1b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 1c */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 1d */ { Drive_Op_Ora, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* 1e */ { Drive_Op_Asl, Drive_Mode_Abx, 7 }, /* 1f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 20 */ { Drive_Op_Jsr, Drive_Mode_Abs, 6 }, /* 21 */ { Drive_Op_And, Drive_Mode_Izx, 6 }, /* 22 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 23 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 24 */ { Drive_Op_Bit, Drive_Mode_Zp, 3 }, /* 25 */ { Drive_Op_And, Drive_Mode_Zp, 3 }, /* 26 */ { Drive_Op_Rol, Drive_Mode_Zp, 5 }, /* 27 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 28 */ { Drive_Op_Plp, Drive_Mode_Imp, 4 }, /* 29 */ { Drive_Op_And, Drive_Mode_Imm, 2 }, /* 2a */ { Drive_Op_Rol, Drive_Mode_Acc, 2 }, /* 2b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 2c */ { Drive_Op_Bit, Drive_Mode_Abs, 4 }, /* 2d */ { Drive_Op_And, Drive_Mode_Abs, 4 }, /* 2e */ { Drive_Op_Rol, Drive_Mode_Abs, 6 }, /* 2f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 30 */ { Drive_Op_Bmi, Drive_Mode_Rel, 2 }, /* 31 */ { Drive_Op_And, Drive_Mode_Izy, 5 | DRIVE_PAGE_PENALTY }, /* 32 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 33 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 34 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 35 */ { Drive_Op_And, Drive_Mode_Zpx, 4 }, /* 36 */ { Drive_Op_Rol, Drive_Mode_Zpx, 6 }, /* 37 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 38 */ { Drive_Op_Sec, Drive_Mode_Imp, 2 }, /* 39 */ { Drive_Op_And, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* 3a */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 3b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 3c */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 3d */ { Drive_Op_And, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* 3e */ { Drive_Op_Rol, Drive_Mode_Abx, 7 }, /* 3f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 40 */ { Drive_Op_Rti, Drive_Mode_Imp, 6 }, /* 41 */ { Drive_Op_Eor, Drive_Mode_Izx, 6 }, /* 42 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 43 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 44 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 45 */ { Drive_Op_Eor, Drive_Mode_Zp, 3 }, /* 46 */ { Drive_Op_Lsr, Drive_Mode_Zp, 5 }, /* 47 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 48 */ { Drive_Op_Pha, Drive_Mode_Imp, 3 }, /* 49 */ { Drive_Op_Eor, Drive_Mode_Imm, 2 }, /* 4a */ { Drive_Op_Lsr, Drive_Mode_Acc, 2 }, /* 4b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 4c */ { Drive_Op_Jmp, Drive_Mode_Abs, 3 }, /* 4d */ { Drive_Op_Eor, Drive_Mode_Abs, 4 }, /* 4e */ { Drive_Op_Lsr, Drive_Mode_Abs, 6 }, /* 4f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 50 */ { Drive_Op_Bvc, Drive_Mode_Rel, 2 }, /* 51 */ { Drive_Op_Eor, Drive_Mode_Izy, 5 | DRIVE_PAGE_PENALTY }, /* 52 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 53 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 54 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 55 */ { Drive_Op_Eor, Drive_Mode_Zpx, 4 }, /* 56 */ { Drive_Op_Lsr, Drive_Mode_Zpx, 6 }, /* 57 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 58 */ { Drive_Op_Cli, Drive_Mode_Imp, 2 }, /* 59 */ { Drive_Op_Eor, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* 5a */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 5b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 5c */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 5d */ { Drive_Op_Eor, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* 5e */ { Drive_Op_Lsr, Drive_Mode_Abx, 7 }, /* 5f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 60 */ { Drive_Op_Rts, Drive_Mode_Imp, 6 }, /* 61 */ { Drive_Op_Adc, Drive_Mode_Izx, 6 }, /* 62 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 63 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 64 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 65 */ { Drive_Op_Adc, Drive_Mode_Zp, 3 }, /* 66 */ { Drive_Op_Ror, Drive_Mode_Zp, 5 }, /* 67 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 68 */ { Drive_Op_Pla, Drive_Mode_Imp, 4 }, /* 69 */ { Drive_Op_Adc, Drive_Mode_Imm, 2 }, /* 6a */ { Drive_Op_Ror, Drive_Mode_Acc, 2 }, /* 6b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 6c */ { Drive_Op_Jmp, Drive_Mode_Ind, 5 }, /* 6d */ { Drive_Op_Adc, Drive_Mode_Abs, 4 }, /* 6e */ { Drive_Op_Ror, Drive_Mode_Abs, 6 }, /* 6f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 70 */ { Drive_Op_Bvs, Drive_Mode_Rel, 2 }, /* 71 */ { Drive_Op_Adc, Drive_Mode_Izy, 5 | DRIVE_PAGE_PENALTY }, /* 72 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 73 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 74 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 75 */ { Drive_Op_Adc, Drive_Mode_Zpx, 4 }, /* 76 */ { Drive_Op_Ror, Drive_Mode_Zpx, 6 }, /* 77 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 78 */ { Drive_Op_Sei, Drive_Mode_Imp, 2 }, /* 79 */ { Drive_Op_Adc, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* 7a */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 7b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 7c */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 7d */ { Drive_Op_Adc, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* 7e */ { Drive_Op_Ror, Drive_Mode_Abx, 7 }, /* 7f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 80 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 81 */ { Drive_Op_Sta, Drive_Mode_Izx, 6 }, /* 82 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 83 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 84 */ { Drive_Op_Sty, Drive_Mode_Zp, 3 }, /* 85 */ { Drive_Op_Sta, Drive_Mode_Zp, 3 }, /* 86 */ { Drive_Op_Stx, Drive_Mode_Zp, 3 }, /* 87 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 88 */ { Drive_Op_Dey, Drive_Mode_Imp, 2 }, /* 89 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 8a */ { Drive_Op_Txa, Drive_Mode_Imp, 2 }, /* 8b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 8c */ { Drive_Op_Sty, Drive_Mode_Abs, 4 }, /* 8d */ { Drive_Op_Sta, Drive_Mode_Abs, 4 }, /* 8e */ { Drive_Op_Stx, Drive_Mode_Abs, 4 }, /* 8f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 90 */ { Drive_Op_Bcc, Drive_Mode_Rel, 2 }, /* 91 */ { Drive_Op_Sta, Drive_Mode_Izy, 6 }, /* 92 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 93 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 94 */ { Drive_Op_Sty, Drive_Mode_Zpx, 4 }, /* 95 */ { Drive_Op_Sta, Drive_Mode_Zpx, 4 }, /* 96 */ { Drive_Op_Stx, Drive_Mode_Zpy, 4 }, /* 97 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 98 */ { Drive_Op_Tya, Drive_Mode_Imp, 2 }, /* 99 */ { Drive_Op_Sta, Drive_Mode_Aby, 5 }, /* 9a */ { Drive_Op_Txs, Drive_Mode_Imp, 2 }, /* 9b */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* 9c */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 9d */ { Drive_Op_Sta, Drive_Mode_Abx, 5 }, /* 9e */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* 9f */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* a0 */ { Drive_Op_Ldy, Drive_Mode_Imm, 2 }, /* a1 */ { Drive_Op_Lda, Drive_Mode_Izx, 6 }, /* a2 */ { Drive_Op_Ldx, Drive_Mode_Imm, 2 }, /* a3 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* a4 */ { Drive_Op_Ldy, Drive_Mode_Zp, 3 }, /* a5 */ { Drive_Op_Lda, Drive_Mode_Zp, 3 }, /* a6 */ { Drive_Op_Ldx, Drive_Mode_Zp, 3 }, /* a7 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* a8 */ { Drive_Op_Tay, Drive_Mode_Imp, 2 }, /* a9 */ { Drive_Op_Lda, Drive_Mode_Imm, 2 }, /* aa */ { Drive_Op_Tax, Drive_Mode_Imp, 2 }, /* ab */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* ac */ { Drive_Op_Ldy, Drive_Mode_Abs, 4 }, /* ad */ { Drive_Op_Lda, Drive_Mode_Abs, 4 }, /* ae */ { Drive_Op_Ldx, Drive_Mode_Abs, 4 }, /* af */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* b0 */ { Drive_Op_Bcs, Drive_Mode_Rel, 2 }, /* b1 */ { Drive_Op_Lda, Drive_Mode_Izy, 5 | DRIVE_PAGE_PENALTY }, /* b2 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* b3 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* b4 */ { Drive_Op_Ldy, Drive_Mode_Zpx, 4 }, /* b5 */ { Drive_Op_Lda, Drive_Mode_Zpx, 4 }, /* b6 */ { Drive_Op_Ldx, Drive_Mode_Zpy, 4 }, /* b7 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* b8 */ { Drive_Op_Clv, Drive_Mode_Imp, 2 }, /* b9 */ { Drive_Op_Lda, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* ba */ { Drive_Op_Tsx, Drive_Mode_Imp, 2 }, /* bb */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* bc */ { Drive_Op_Ldy, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* bd */ { Drive_Op_Lda, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* be */ { Drive_Op_Ldx, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* bf */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* c0 */ { Drive_Op_Cpy, Drive_Mode_Imm, 2 }, /* c1 */ { Drive_Op_Cmp, Drive_Mode_Izx, 6 }, /* c2 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* c3 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* c4 */ { Drive_Op_Cpy, Drive_Mode_Zp, 3 }, /* c5 */ { Drive_Op_Cmp, Drive_Mode_Zp, 3 }, /* c6 */ { Drive_Op_Dec, Drive_Mode_Zp, 5 }, /* c7 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* c8 */ { Drive_Op_Iny, Drive_Mode_Imp, 2 }, /* c9 */ { Drive_Op_Cmp, Drive_Mode_Imm, 2 }, /* ca */ { Drive_Op_Dex, Drive_Mode_Imp, 2 }, /* cb */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* cc */ { Drive_Op_Cpy, Drive_Mode_Abs, 4 }, /* cd */ { Drive_Op_Cmp, Drive_Mode_Abs, 4 }, /* ce */ { Drive_Op_Dec, Drive_Mode_Abs, 6 }, /* cf */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* d0 */ { Drive_Op_Bne, Drive_Mode_Rel, 2 }, /* d1 */ { Drive_Op_Cmp, Drive_Mode_Izy, 5 | DRIVE_PAGE_PENALTY }, /* d2 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* d3 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* d4 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* d5 */ { Drive_Op_Cmp, Drive_Mode_Zpx, 4 }, /* d6 */ { Drive_Op_Dec, Drive_Mode_Zpx, 6 }, /* d7 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* d8 */ { Drive_Op_Cld, Drive_Mode_Imp, 2 }, /* d9 */ { Drive_Op_Cmp, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* da */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* db */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* dc */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* dd */ { Drive_Op_Cmp, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* de */ { Drive_Op_Dec, Drive_Mode_Abx, 7 }, /* df */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* e0 */ { Drive_Op_Cpx, Drive_Mode_Imm, 2 }, /* e1 */ { Drive_Op_Sbc, Drive_Mode_Izx, 6 }, /* e2 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* e3 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* e4 */ { Drive_Op_Cpx, Drive_Mode_Zp, 3 }, /* e5 */ { Drive_Op_Sbc, Drive_Mode_Zp, 3 }, /* e6 */ { Drive_Op_Inc, Drive_Mode_Zp, 5 }, /* e7 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* e8 */ { Drive_Op_Inx, Drive_Mode_Imp, 2 }, /* e9 */ { Drive_Op_Sbc, Drive_Mode_Imm, 2 }, /* ea */ { Drive_Op_Nop, Drive_Mode_Imp, 2 }, /* eb */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* ec */ { Drive_Op_Cpx, Drive_Mode_Abs, 4 }, /* ed */ { Drive_Op_Sbc, Drive_Mode_Abs, 4 }, /* ee */ { Drive_Op_Inc, Drive_Mode_Abs, 6 }, /* ef */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* f0 */ { Drive_Op_Beq, Drive_Mode_Rel, 2 }, /* f1 */ { Drive_Op_Sbc, Drive_Mode_Izy, 5 | DRIVE_PAGE_PENALTY }, /* f2 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* f3 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* f4 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* f5 */ { Drive_Op_Sbc, Drive_Mode_Zpx, 4 }, /* f6 */ { Drive_Op_Inc, Drive_Mode_Zpx, 6 }, /* f7 */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* f8 */ { Drive_Op_Sed, Drive_Mode_Imp, 2 }, /* f9 */ { Drive_Op_Sbc, Drive_Mode_Aby, 4 | DRIVE_PAGE_PENALTY }, /* fa */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* fb */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+    /* fc */ { Drive_Op_Jam, Drive_Mode_Imp, 2 }, /* fd */ { Drive_Op_Sbc, Drive_Mode_Abx, 4 | DRIVE_PAGE_PENALTY }, /* fe */ { Drive_Op_Inc, Drive_Mode_Abx, 7 }, /* ff */ { Drive_Op_Jam, Drive_Mode_Imp, 2 },
+};
+
+typedef struct
+{
+    uint8_t reg[16];
+    uint16_t latch;   // timer 1
+    uint32_t started; // cycle count when timer 1 was loaded
+} Drive_Via_t;
+
+static struct
+{
+    uint8_t* ram; // borrowed from the listing while drive code is around
+    uint16_t generation; // listing generation at the borrow, see Drive_isOwner()
+    uint16_t pc;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t sp;
+    uint8_t p;
+    uint32_t cycles;
+    uint32_t portCycles; // cycle count at the last VIA1 port access
+    Drive_Via_t via1;
+    Drive_Via_t via2;
+    uint8_t pendingJobs; // bit n: job n was written with bit 7 set
+    bool isRunning;
+    bool wasJsr;         // last instruction was a JSR, a call into rom just returns
+
+    /* execute job, the buffer code runs as a subroutine of the interrupted code */
+    struct
+    {
+        bool isActive;
+        uint8_t index;
+        uint8_t sp;
+        uint16_t pc;
+    } job;
+
+    struct
+    {
+        uint32_t cycles;        // cycle count the clock was last caught up at
+        uint32_t clock;         // IEC_getDirectClock() then
+        uint32_t ticksPerCycle; // one drive cycle is a microsecond
+    } pace;
+} drive;
+
+static bool Drive_begin(void);
+static bool Drive_isOwner(void);
+static void Drive_step(void);
+static bool Drive_isStalled(void);
+#ifndef WIN32
+static void Drive_pace(void);
+#endif
+static void Drive_enterRom(void);
+static void Drive_runJobs(void);
+static void Drive_endJob(void);
+static uint8_t Drive_read(const uint16_t address);
+static void Drive_write(const uint16_t address, const uint8_t value);
+static uint8_t Drive_readVia(Drive_Via_t* const via, const uint8_t reg);
+static void Drive_writeVia(Drive_Via_t* const via, const uint8_t reg, const uint8_t value);
+static uint16_t Drive_getTimer1(const Drive_Via_t* const via);
+static uint8_t Drive_readPort(void);
+static void Drive_writePort(void);
+static uint16_t Drive_getAddress(const Drive_Mode_t mode, bool* const isPageCrossed);
+static void Drive_push(const uint8_t value);
+static uint8_t Drive_pull(void);
+static void Drive_setNZ(const uint8_t value);
+static void Drive_setFlag(const uint8_t flag, const bool isSet);
+static void Drive_branch(const bool isTaken, const uint16_t target, uint8_t* const cycles);
+static void Drive_compare(const uint8_t reg, const uint8_t value);
+static void Drive_addWithCarry(const uint8_t value);
+static void Drive_subtractWithCarry(const uint8_t value);
+
+void Drive_writeMemory(const uint16_t address, const uint8_t* const data, const uint8_t count)
+{
+    if ((!Drive_isOwner()) && (!Drive_begin()))
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Drive_write((uint16_t) (address + i), data[i]);
+    }
+}
+
+void Drive_execute(const uint16_t address)
+{
+    if (!Drive_isOwner())
+    {
+        /* nothing was written, or a LOAD"$" has since rendered over it */
+        return;
+    }
+
+    /* called like a dos routine, returning to the rom ends it */
+    drive.sp = 0xff;
+    Drive_push((uint8_t) ((DRIVE_ROM_BASE - 1u) >> 8));
+    Drive_push((uint8_t) ((DRIVE_ROM_BASE - 1u) & 0xff));
+    drive.pc = address;
+    drive.p = DRIVE_FLAG_U | DRIVE_FLAG_I;
+    drive.wasJsr = false;
+    drive.job.isActive = false;
+    drive.isRunning = true;
+    drive.portCycles = drive.cycles;
+
+    IEC_setDirect(true);
+
+    drive.pace.cycles = drive.cycles;
+    drive.pace.clock = IEC_getDirectClock();
+    drive.pace.ticksPerCycle = IEC_getClockTicks(1);
+}
+
+uint32_t Drive_run(const uint32_t cycles)
+{
+    const uint32_t start = drive.cycles;
+
+    while ((drive.isRunning) && ((drive.cycles - start) < cycles))
+    {
+        if ((0 != drive.pendingJobs) && (!drive.job.isActive))
+        {
+            Drive_runJobs();
+        }
+
+        Drive_step();
+
+        if (Drive_isStalled())
+        {
+            Drive_stop();
+            break;
+        }
+
+#ifndef WIN32
+        Drive_pace();
+#endif
+    }
+
+    return (drive.cycles - start);
+}
+
+bool Drive_isRunning(void)
+{
+    return (drive.isRunning);
+}
+
+void Drive_stop(void)
+{
+    if (drive.isRunning)
+    {
+        drive.isRunning = false;
+        IEC_setDirect(false);
+    }
+
+    /* the listing is rendered again when it is next asked for */
+    drive.ram = NULL;
+}
+
+#ifdef WIN32
+uint32_t Drive_benchmark(const uint32_t cycles)
+{
+    /* a counting loop that touches ram, the VIA and branches: */
+    /* loop: inc $10 / lda $1800 / ldx #$08 / dex / bne -3 / jmp loop */
+    static const uint8_t code[] = {
+        0xe6, 0x10, 0xad, 0x00, 0x18, 0xa2, 0x08, 0xca, 0xd0, 0xfd, 0x4c, 0x00, 0x05,
+    };
+
+    Drive_writeMemory(0x0500, code, sizeof(code));
+    Drive_execute(0x0500);
+
+    const clock_t begin = clock();
+    const uint32_t done = Drive_run(cycles);
+    const clock_t end = clock();
+
+    Drive_stop();
+
+    const double seconds = (double) (end - begin) / CLOCKS_PER_SEC;
+    return ((seconds > 0.0) ? (uint32_t) (done / seconds) : 0u);
+}
+#endif
+
+static bool Drive_begin(void)
+{
+    size_t size = 0;
+    uint8_t* const ram = D64_borrowListing(&size);
+
+    if (size < DRIVE_RAM_SIZE)
+    {
+        return (false);
+    }
+
+    memset(ram, 0, DRIVE_RAM_SIZE);
+    memset(&drive, 0, sizeof(drive));
+    drive.ram = ram;
+    drive.generation = D64_getListingGeneration();
+    drive.via1.reg[DRIVE_VIA_DDRB] = DRIVE_PORT_DDR;
+
+    return (true);
+}
+
+static bool Drive_isOwner(void)
+{
+    /* M-W without M-E keeps the ram, until the listing is rendered into it again */
+    return ((NULL != drive.ram) && (D64_getListingGeneration() == drive.generation));
+}
+
+static bool Drive_isStalled(void)
+{
+    const uint32_t idle = drive.cycles - drive.portCycles;
+
+    if (idle < DRIVE_ATN_IDLE_CYCLES)
+    {
+        return (false);
+    }
+
+    /* a loader polls the port for ATN, one that does not will never give the bus back */
+    return ((idle >= DRIVE_IDLE_CYCLES) || (IEC_Input_True == IEC_readATN()));
+}
+
+#ifndef WIN32
+static void Drive_pace(void)
+{
+    /* cycle counted transfer loops need the real 1 MHz, never run ahead of it */
+    const uint32_t due = (drive.cycles - drive.pace.cycles) * drive.pace.ticksPerCycle;
+    const uint32_t now = IEC_getDirectClock();
+
+    if ((now - drive.pace.clock) >= due)
+    {
+        /* behind, time lost in slow instructions is not made up for */
+        drive.pace.cycles = drive.cycles;
+        drive.pace.clock = now;
+        return;
+    }
+
+    while ((IEC_getDirectClock() - drive.pace.clock) < due)
+    {
+    }
+}
+#endif
+
+static void Drive_step(void)
+{
+    if (drive.pc >= DRIVE_ROM_BASE)
+    {
+        Drive_enterRom();
+        return;
+    }
+
+    const Drive_Opcode_t* const opcode = &opcodes[Drive_read(drive.pc)];
+    drive.pc++;
+
+    bool isPageCrossed = false;
+    const uint16_t address = Drive_getAddress((Drive_Mode_t) opcode->mode, &isPageCrossed);
+    uint8_t cycles = opcode->cycles & DRIVE_CYCLES_MASK;
+
+    if (isPageCrossed && (opcode->cycles & DRIVE_PAGE_PENALTY))
+    {
+        cycles++;
+    }
+
+    const bool isAcc = (Drive_Mode_Acc == opcode->mode);
+    drive.wasJsr = false;
+
+    switch (opcode->op)
+    {
+        case Drive_Op_Adc: Drive_addWithCarry(Drive_read(address)); break;
+        case Drive_Op_Sbc: Drive_subtractWithCarry(Drive_read(address)); break;
+        case Drive_Op_And: drive.a &= Drive_read(address); Drive_setNZ(drive.a); break;
+        case Drive_Op_Ora: drive.a |= Drive_read(address); Drive_setNZ(drive.a); break;
+        case Drive_Op_Eor: drive.a ^= Drive_read(address); Drive_setNZ(drive.a); break;
+        case Drive_Op_Lda: drive.a = Drive_read(address); Drive_setNZ(drive.a); break;
+        case Drive_Op_Ldx: drive.x = Drive_read(address); Drive_setNZ(drive.x); break;
+        case Drive_Op_Ldy: drive.y = Drive_read(address); Drive_setNZ(drive.y); break;
+        case Drive_Op_Sta: Drive_write(address, drive.a); break;
+        case Drive_Op_Stx: Drive_write(address, drive.x); break;
+        case Drive_Op_Sty: Drive_write(address, drive.y); break;
+        case Drive_Op_Cmp: Drive_compare(drive.a, Drive_read(address)); break;
+        case Drive_Op_Cpx: Drive_compare(drive.x, Drive_read(address)); break;
+        case Drive_Op_Cpy: Drive_compare(drive.y, Drive_read(address)); break;
+
+        case Drive_Op_Bit:
+        {
+            const uint8_t value = Drive_read(address);
+            Drive_setFlag(DRIVE_FLAG_Z, 0 == (drive.a & value));
+            drive.p = (drive.p & ~(DRIVE_FLAG_N | DRIVE_FLAG_V)) | (value & (DRIVE_FLAG_N | DRIVE_FLAG_V));
+            break;
+        }
+
+        case Drive_Op_Asl:
+        case Drive_Op_Lsr:
+        case Drive_Op_Rol:
+        case Drive_Op_Ror:
+        {
+            const uint8_t value = isAcc ? drive.a : Drive_read(address);
+            const uint8_t carry = drive.p & DRIVE_FLAG_C;
+            uint8_t result;
+
+            if ((Drive_Op_Asl == opcode->op) || (Drive_Op_Rol == opcode->op))
+            {
+                result = (uint8_t) ((value << 1) | ((Drive_Op_Rol == opcode->op) ? carry : 0u));
+                Drive_setFlag(DRIVE_FLAG_C, 0 != (value & 0x80u));
+            }
+            else
+            {
+                result = (uint8_t) ((value >> 1) | (((Drive_Op_Ror == opcode->op) && carry) ? 0x80u : 0u));
+                Drive_setFlag(DRIVE_FLAG_C, 0 != (value & 0x01u));
+            }
+
+            Drive_setNZ(result);
+            if (isAcc)
+            {
+                drive.a = result;
+            }
+            else
+            {
+                Drive_write(address, result);
+            }
+            break;
+        }
+
+        case Drive_Op_Inc:
+        case Drive_Op_Dec:
+        {
+            const uint8_t result = (uint8_t) (Drive_read(address) + ((Drive_Op_Inc == opcode->op) ? 1 : -1));
+            Drive_setNZ(result);
+            Drive_write(address, result);
+            break;
+        }
+
+        case Drive_Op_Inx: drive.x++; Drive_setNZ(drive.x); break;
+        case Drive_Op_Iny: drive.y++; Drive_setNZ(drive.y); break;
+        case Drive_Op_Dex: drive.x--; Drive_setNZ(drive.x); break;
+        case Drive_Op_Dey: drive.y--; Drive_setNZ(drive.y); break;
+        case Drive_Op_Tax: drive.x = drive.a; Drive_setNZ(drive.x); break;
+        case Drive_Op_Tay: drive.y = drive.a; Drive_setNZ(drive.y); break;
+        case Drive_Op_Txa: drive.a = drive.x; Drive_setNZ(drive.a); break;
+        case Drive_Op_Tya: drive.a = drive.y; Drive_setNZ(drive.a); break;
+        case Drive_Op_Tsx: drive.x = drive.sp; Drive_setNZ(drive.x); break;
+        case Drive_Op_Txs: drive.sp = drive.x; break;
+
+        case Drive_Op_Bcc: Drive_branch(0 == (drive.p & DRIVE_FLAG_C), address, &cycles); break;
+        case Drive_Op_Bcs: Drive_branch(0 != (drive.p & DRIVE_FLAG_C), address, &cycles); break;
+        case Drive_Op_Bne: Drive_branch(0 == (drive.p & DRIVE_FLAG_Z), address, &cycles); break;
+        case Drive_Op_Beq: Drive_branch(0 != (drive.p & DRIVE_FLAG_Z), address, &cycles); break;
+        case Drive_Op_Bpl: Drive_branch(0 == (drive.p & DRIVE_FLAG_N), address, &cycles); break;
+        case Drive_Op_Bmi: Drive_branch(0 != (drive.p & DRIVE_FLAG_N), address, &cycles); break;
+        case Drive_Op_Bvc: Drive_branch(0 == (drive.p & DRIVE_FLAG_V), address, &cycles); break;
+        case Drive_Op_Bvs: Drive_branch(0 != (drive.p & DRIVE_FLAG_V), address, &cycles); break;
+
+        case Drive_Op_Clc: drive.p &= ~DRIVE_FLAG_C; break;
+        case Drive_Op_Cld: drive.p &= ~DRIVE_FLAG_D; break;
+        case Drive_Op_Cli: drive.p &= ~DRIVE_FLAG_I; break;
+        case Drive_Op_Clv: drive.p &= ~DRIVE_FLAG_V; break;
+        case Drive_Op_Sec: drive.p |= DRIVE_FLAG_C; break;
+        case Drive_Op_Sed: drive.p |= DRIVE_FLAG_D; break;
+        case Drive_Op_Sei: drive.p |= DRIVE_FLAG_I; break;
+
+        case Drive_Op_Pha: Drive_push(drive.a); break;
+        case Drive_Op_Php: Drive_push(drive.p | DRIVE_FLAG_B | DRIVE_FLAG_U); break;
+        case Drive_Op_Pla: drive.a = Drive_pull(); Drive_setNZ(drive.a); break;
+        case Drive_Op_Plp: drive.p = Drive_pull() | DRIVE_FLAG_U; break;
+
+        case Drive_Op_Jmp: drive.pc = address; break;
+
+        case Drive_Op_Jsr:
+            drive.pc--;
+            Drive_push((uint8_t) (drive.pc >> 8));
+            Drive_push((uint8_t) (drive.pc & 0xff));
+            drive.pc = address;
+            drive.wasJsr = true;
+            break;
+
+        case Drive_Op_Rts:
+            if ((drive.job.isActive) && (drive.sp == drive.job.sp))
+            {
+                Drive_endJob();
+                break;
+            }
+            drive.pc = Drive_pull();
+            drive.pc |= (uint16_t) (Drive_pull() << 8);
+            drive.pc++;
+            break;
+
+        case Drive_Op_Rti:
+            drive.p = Drive_pull() | DRIVE_FLAG_U;
+            drive.pc = Drive_pull();
+            drive.pc |= (uint16_t) (Drive_pull() << 8);
+            break;
+
+        case Drive_Op_Nop:
+            break;
+
+        default:
+            /* BRK and the illegal opcodes, without the rom there is nowhere to go */
+            Drive_stop();
+            break;
+    }
+
+    drive.cycles += cycles;
+}
+
+static void Drive_enterRom(void)
+{
+    if (drive.job.isActive)
+    {
+        /* job code ends by jumping back into the controller loop */
+        Drive_endJob();
+    }
+    else if (drive.wasJsr)
+    {
+        /* a call into the dos rom, it returns at once as if it did nothing */
+        drive.pc = Drive_pull();
+        drive.pc |= (uint16_t) (Drive_pull() << 8);
+        drive.pc++;
+        drive.wasJsr = false;
+        drive.cycles += 6u;
+    }
+    else
+    {
+        /* back to the dos idle loop */
+        Drive_stop();
+    }
+}
+
+static void Drive_runJobs(void)
+{
+    for (uint8_t n = 0; n < DRIVE_NUM_JOBS; n++)
+    {
+        const uint8_t bit = (uint8_t) (1u << n);
+
+        if (0 == (drive.pendingJobs & bit))
+        {
+            continue;
+        }
+        drive.pendingJobs &= (uint8_t) ~bit;
+
+        const uint8_t job = drive.ram[n];
+        const uint8_t track = drive.ram[DRIVE_JOB_HEADERS + (2u * n)];
+        const uint8_t sector = drive.ram[DRIVE_JOB_HEADERS + (2u * n) + 1u];
+        uint8_t* const buffer = &drive.ram[DRIVE_JOB_BUFFERS + (n * D64_FIELD_SIZE_SECTOR)];
+
+        switch (job & 0xf0)
+        {
+            case DRIVE_JOB_READ:
+                drive.ram[n] = D64_readSector(track, sector, buffer) ? DRIVE_JOB_OK : DRIVE_JOB_NO_HEADER;
+                break;
+
+            case DRIVE_JOB_WRITE:
+                drive.ram[n] = D64_writeSector(track, sector, buffer) ? DRIVE_JOB_OK : DRIVE_JOB_PROTECTED;
+                break;
+
+            case DRIVE_JOB_JUMP:
+            case DRIVE_JOB_EXECUTE:
+                /* buffer code runs from here, the job byte is set when it returns */
+                drive.job.isActive = true;
+                drive.job.index = n;
+                drive.job.sp = drive.sp;
+                drive.job.pc = drive.pc;
+                drive.pc = DRIVE_JOB_BUFFERS + (n * D64_FIELD_SIZE_SECTOR);
+                return;
+
+            default:
+                /* seek, bump and verify, flash has no head to move */
+                drive.ram[n] = DRIVE_JOB_OK;
+                break;
+        }
+    }
+}
+
+static void Drive_endJob(void)
+{
+    drive.ram[drive.job.index] = DRIVE_JOB_OK;
+    drive.sp = drive.job.sp;
+    drive.pc = drive.job.pc;
+    drive.job.isActive = false;
+}
+
+static uint8_t Drive_read(const uint16_t address)
+{
+    if (address < DRIVE_VIA1_BASE)
+    {
+        return (drive.ram[address & DRIVE_RAM_MASK]);
+    }
+
+    if (DRIVE_VIA1_BASE == (address & DRIVE_VIA_AREA))
+    {
+        return (Drive_readVia(&drive.via1, (uint8_t) (address & DRIVE_VIA_REG)));
+    }
+
+    if (DRIVE_VIA2_BASE == (address & DRIVE_VIA_AREA))
+    {
+        return (Drive_readVia(&drive.via2, (uint8_t) (address & DRIVE_VIA_REG)));
+    }
+
+    if (address >= DRIVE_ROM_BASE)
+    {
+        return (DRIVE_OPCODE_RTS);
+    }
+
+    return ((uint8_t) (address >> 8));
+}
+
+static void Drive_write(const uint16_t address, const uint8_t value)
+{
+    if (address < DRIVE_VIA1_BASE)
+    {
+        const uint16_t ram = address & DRIVE_RAM_MASK;
+        drive.ram[ram] = value;
+
+        /* the controller side picks jobs up between instructions */
+        if ((ram < DRIVE_NUM_JOBS) && (value & 0x80u))
+        {
+            drive.pendingJobs |= (uint8_t) (1u << ram);
+        }
+    }
+    else if (DRIVE_VIA1_BASE == (address & DRIVE_VIA_AREA))
+    {
+        Drive_writeVia(&drive.via1, (uint8_t) (address & DRIVE_VIA_REG), value);
+
+        if ((DRIVE_VIA_ORB == (address & DRIVE_VIA_REG)) || (DRIVE_VIA_DDRB == (address & DRIVE_VIA_REG)))
+        {
+            Drive_writePort();
+        }
+    }
+    else if (DRIVE_VIA2_BASE == (address & DRIVE_VIA_AREA))
+    {
+        Drive_writeVia(&drive.via2, (uint8_t) (address & DRIVE_VIA_REG), value);
+    }
+}
+
+static uint8_t Drive_readVia(Drive_Via_t* const via, const uint8_t reg)
+{
+    switch (reg)
+    {
+        case DRIVE_VIA_ORB:
+            return ((&drive.via1 == via) ? Drive_readPort() : via->reg[reg]);
+
+        case DRIVE_VIA_T1CL:
+            via->reg[DRIVE_VIA_IFR] &= (uint8_t) ~DRIVE_VIA_IFR_T1;
+            return ((uint8_t) (Drive_getTimer1(via) & 0xff));
+
+        case DRIVE_VIA_T1CH:
+            return ((uint8_t) (Drive_getTimer1(via) >> 8));
+
+        case DRIVE_VIA_IFR:
+            if ((drive.cycles - via->started) > via->latch)
+            {
+                via->reg[DRIVE_VIA_IFR] |= DRIVE_VIA_IFR_T1;
+            }
+            return (via->reg[DRIVE_VIA_IFR]);
+
+        default:
+            return (via->reg[reg]);
+    }
+}
+
+static void Drive_writeVia(Drive_Via_t* const via, const uint8_t reg, const uint8_t value)
+{
+    switch (reg)
+    {
+        case DRIVE_VIA_T1CL:
+        case DRIVE_VIA_T1LL:
+            via->reg[DRIVE_VIA_T1LL] = value;
+            break;
+
+        case DRIVE_VIA_T1CH:
+            /* loads the counter from the latch and starts it */
+            via->reg[DRIVE_VIA_T1LH] = value;
+            via->latch = (uint16_t) (via->reg[DRIVE_VIA_T1LL] | (value << 8));
+            via->started = drive.cycles;
+            via->reg[DRIVE_VIA_IFR] &= (uint8_t) ~DRIVE_VIA_IFR_T1;
+            break;
+
+        case DRIVE_VIA_IFR:
+            via->reg[DRIVE_VIA_IFR] &= (uint8_t) ~value; // write one to clear
+            break;
+
+        default:
+            via->reg[reg] = value;
+            break;
+    }
+}
+
+static uint16_t Drive_getTimer1(const Drive_Via_t* const via)
+{
+    /* counts down once per cycle and wraps, free running is close enough for delay loops */
+    return ((uint16_t) (via->latch - (drive.cycles - via->started)));
+}
+
+static uint8_t Drive_readPort(void)
+{
+    const uint8_t ddr = drive.via1.reg[DRIVE_VIA_DDRB];
+    uint8_t inputs = 0;
+
+    if (IEC_Input_True == IEC_readDAT())
+    {
+        inputs |= DRIVE_PORT_DATA_IN;
+    }
+    if (IEC_Input_True == IEC_readCLK())
+    {
+        inputs |= DRIVE_PORT_CLK_IN;
+    }
+    if (IEC_Input_True == IEC_readATN())
+    {
+        inputs |= DRIVE_PORT_ATN_IN;
+    }
+
+    /* ATN may have moved since the port was written, keep the hardware ack in step */
+    Drive_writePort();
+
+    return ((uint8_t) ((drive.via1.reg[DRIVE_VIA_ORB] & ddr) | (inputs & ~ddr)));
+}
+
+static void Drive_writePort(void)
+{
+    drive.portCycles = drive.cycles;
+
+    const uint8_t out = drive.via1.reg[DRIVE_VIA_ORB] & drive.via1.reg[DRIVE_VIA_DDRB];
+
+    /* the 1541 pulls DATA in hardware while ATN and ATNA disagree */
+    const bool isAtn = (IEC_Input_True == IEC_readATN());
+    const bool isAtnAck = (0 != (out & DRIVE_PORT_ATNA));
+
+    IEC_setCLK((out & DRIVE_PORT_CLK_OUT) ? IEC_Output_True : IEC_Output_False);
+    IEC_setDAT(((out & DRIVE_PORT_DATA_OUT) || (isAtn != isAtnAck)) ? IEC_Output_True : IEC_Output_False);
+}
+
+static uint16_t Drive_getAddress(const Drive_Mode_t mode, bool* const isPageCrossed)
+{
+    uint16_t address = 0;
+    uint16_t base;
+
+    switch (mode)
+    {
+        case Drive_Mode_Imm:
+            address = drive.pc++;
+            break;
+
+        case Drive_Mode_Zp:
+            address = Drive_read(drive.pc++);
+            break;
+
+        case Drive_Mode_Zpx:
+            address = (uint8_t) (Drive_read(drive.pc++) + drive.x);
+            break;
+
+        case Drive_Mode_Zpy:
+            address = (uint8_t) (Drive_read(drive.pc++) + drive.y);
+            break;
+
+        case Drive_Mode_Abs:
+            address = Drive_read(drive.pc) | (uint16_t) (Drive_read(drive.pc + 1u) << 8);
+            drive.pc += 2u;
+            break;
+
+        case Drive_Mode_Abx:
+        case Drive_Mode_Aby:
+            base = Drive_read(drive.pc) | (uint16_t) (Drive_read(drive.pc + 1u) << 8);
+            drive.pc += 2u;
+            address = (uint16_t) (base + ((Drive_Mode_Abx == mode) ? drive.x : drive.y));
+            *isPageCrossed = ((base & 0xff00u) != (address & 0xff00u));
+            break;
+
+        case Drive_Mode_Ind:
+            /* the nmos 6502 does not carry into the high byte of the pointer */
+            base = Drive_read(drive.pc) | (uint16_t) (Drive_read(drive.pc + 1u) << 8);
+            drive.pc += 2u;
+            address = Drive_read(base) | (uint16_t) (Drive_read((base & 0xff00u) | ((base + 1u) & 0x00ffu)) << 8);
+            break;
+
+        case Drive_Mode_Izx:
+            base = (uint8_t) (Drive_read(drive.pc++) + drive.x);
+            address = Drive_read(base) | (uint16_t) (Drive_read((uint8_t) (base + 1u)) << 8);
+            break;
+
+        case Drive_Mode_Izy:
+            base = Drive_read(drive.pc++);
+            base = Drive_read(base) | (uint16_t) (Drive_read((uint8_t) (base + 1u)) << 8);
+            address = (uint16_t) (base + drive.y);
+            *isPageCrossed = ((base & 0xff00u) != (address & 0xff00u));
+            break;
+
+        case Drive_Mode_Rel:
+        {
+            const int8_t offset = (int8_t) Drive_read(drive.pc++);
+            address = (uint16_t) (drive.pc + offset);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return (address);
+}
+
+static void Drive_push(const uint8_t value)
+{
+    drive.ram[DRIVE_STACK_BASE + drive.sp] = value;
+    drive.sp--;
+}
+
+static uint8_t Drive_pull(void)
+{
+    drive.sp++;
+    return (drive.ram[DRIVE_STACK_BASE + drive.sp]);
+}
+
+static void Drive_setNZ(const uint8_t value)
+{
+    drive.p = (drive.p & ~(DRIVE_FLAG_N | DRIVE_FLAG_Z)) | (value & DRIVE_FLAG_N) | ((0 == value) ? DRIVE_FLAG_Z : 0u);
+}
+
+static void Drive_setFlag(const uint8_t flag, const bool isSet)
+{
+    if (isSet)
+    {
+        drive.p |= flag;
+    }
+    else
+    {
+        drive.p &= (uint8_t) ~flag;
+    }
+}
+
+static void Drive_branch(const bool isTaken, const uint16_t target, uint8_t* const cycles)
+{
+    if (isTaken)
+    {
+        *cycles += ((drive.pc & 0xff00u) != (target & 0xff00u)) ? 2u : 1u;
+        drive.pc = target;
+    }
+}
+
+static void Drive_compare(const uint8_t reg, const uint8_t value)
+{
+    Drive_setFlag(DRIVE_FLAG_C, reg >= value);
+    Drive_setNZ((uint8_t) (reg - value));
+}
+
+static void Drive_addWithCarry(const uint8_t value)
+{
+    const uint8_t carry = drive.p & DRIVE_FLAG_C;
+    const uint16_t sum = drive.a + value + carry;
+
+    Drive_setFlag(DRIVE_FLAG_Z, 0 == (sum & 0xff));
+
+    if (drive.p & DRIVE_FLAG_D)
+    {
+        /* nmos decimal mode, N and V come from the half adjusted result */
+        uint8_t lo = (uint8_t) ((drive.a & 0x0f) + (value & 0x0f) + carry);
+        uint8_t hi = (uint8_t) ((drive.a >> 4) + (value >> 4));
+
+        if (lo > 9)
+        {
+            lo += 6;
+        }
+        if (lo > 0x0f)
+        {
+            hi++;
+        }
+
+        Drive_setFlag(DRIVE_FLAG_N, 0 != (hi & 0x08));
+        Drive_setFlag(DRIVE_FLAG_V, 0 != (~(drive.a ^ value) & (drive.a ^ (hi << 4)) & 0x80));
+
+        if (hi > 9)
+        {
+            hi += 6;
+        }
+
+        Drive_setFlag(DRIVE_FLAG_C, hi > 0x0f);
+        drive.a = (uint8_t) ((hi << 4) | (lo & 0x0f));
+        return;
+    }
+
+    Drive_setFlag(DRIVE_FLAG_C, sum > 0xff);
+    Drive_setFlag(DRIVE_FLAG_V, 0 != (~(drive.a ^ value) & (drive.a ^ sum) & 0x80));
+    drive.a = (uint8_t) sum;
+    Drive_setNZ(drive.a);
+}
+
+static void Drive_subtractWithCarry(const uint8_t value)
+{
+    const uint8_t borrow = (drive.p & DRIVE_FLAG_C) ? 0u : 1u;
+    const uint16_t diff = (uint16_t) (drive.a - value - borrow);
+
+    /* flags follow the binary result in both modes */
+    Drive_setFlag(DRIVE_FLAG_C, diff < 0x100);
+    Drive_setFlag(DRIVE_FLAG_V, 0 != ((drive.a ^ value) & (drive.a ^ diff) & 0x80));
+
+    if (drive.p & DRIVE_FLAG_D)
+    {
+        int8_t lo = (int8_t) ((drive.a & 0x0f) - (value & 0x0f) - borrow);
+        int8_t hi = (int8_t) ((drive.a >> 4) - (value >> 4));
+
+        if (lo < 0)
+        {
+            lo -= 6;
+            hi--;
+        }
+        if (hi < 0)
+        {
+            hi -= 6;
+        }
+
+        Drive_setNZ((uint8_t) diff);
+        drive.a = (uint8_t) ((hi << 4) | (lo & 0x0f));
+        return;
+    }
+
+    drive.a = (uint8_t) diff;
+    Drive_setNZ(drive.a);
+}
@@ -20,6 +20,7 @@ FIFO_Result_t FIFO_init(FIFO_t* const fifo, uint8_t* const buffer, const size_t
     fifo->numBytes = numBytes;
     fifo->head = 0;
     fifo->tail = 0;
+    fifo->numStored = 0;
 
     return (FIFO_Result_Success);
 }
@@ -28,8 +29,14 @@ FIFO_Result_t FIFO_write(FIFO_t* const fifo, uint8_t byte)
 {
     assert(fifo);
 
+    if (fifo->numStored >= fifo->numBytes)
+    {
+        return (FIFO_Result_Failed);
+    }
+
     fifo->buffer[fifo->head] = byte;
     fifo->head = (fifo->head + 1) % fifo->numBytes;
+    fifo->numStored++;
 
     return (FIFO_Result_Success);
 }
@@ -38,8 +45,14 @@ FIFO_Result_t FIFO_read(FIFO_t* const fifo, uint8_t* byte)
 {
     assert(fifo);
 
+    if (0 == fifo->numStored)
+    {
+        return (FIFO_Result_Failed);
+    }
+
     *byte = fifo->buffer[fifo->tail];
     fifo->tail = (fifo->tail + 1) % fifo->numBytes;
+    fifo->numStored--;
 
     return (FIFO_Result_Success);
 }
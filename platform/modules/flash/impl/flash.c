@@ -11,6 +11,11 @@
 #include <stdlib.h>
 
 // TODO: Implement functions
+uint32_t Flash_getImageSize(void)
+{
+    return (0);
+}
+
 uint8_t Flash_readByte(const uint32_t addr)
 {
     return (0);
@@ -25,3 +30,13 @@ void Flash_seek(const uint32_t offset, const Flash_Mode_t mode)
 {
 
 }
+
+void Flash_eraseBlock(const uint32_t addr)
+{
+
+}
+
+void Flash_writeBlock(const uint32_t addr, const size_t size, const uint8_t* const src)
+{
+
+}
@@ -6,279 +6,1325 @@
  */
 
 #include "iecIface.h"
+#include "iecPins.h"
 
 #include <stdint.h>         /* For uint8_t definition */
 #include <stdbool.h>        /* For true/false definition */
+#include <stdlib.h>
 
 #ifndef WIN32
-#include "fsl_gpio.h"
+#include "board.h"
+#include "kexx_gpio.h"
+#include "kexx_kbi.h"
+#include "kexx_timer.h"
 #endif
 
-#include "d64Iface.h"
-#include "fifoIface.h"
-#include "delayIface.h"
-
 #undef USE_IEC_ATN_MACRO
 
-static uint8_t fifoBuffer[D64_FIELD_SIZE_NAME];
+/* bus pins that raise edge interrupts, see board.h */
+#ifndef WIN32
+#define IEC_ATN_PIN  (BOARD_IEC_ATN_IN_PIN)
+#define IEC_CLK_PIN  (BOARD_IEC_CLK_IN_PIN)
+#define IEC_DATA_PIN (BOARD_IEC_DATA_IN_PIN)
+#define IEC_enterCritical() __disable_irq()
+#define IEC_exitCritical()  __enable_irq()
+#else
+#define IEC_ATN_PIN  (0u)
+#define IEC_CLK_PIN  (1u)
+#define IEC_DATA_PIN (2u)
+#define IEC_enterCritical()
+#define IEC_exitCritical()
+#endif
+
+/* received bytes, filled from the bus interrupts and emptied by the state machine */
+#define IEC_RX_QUEUE_SIZE (32u) // power of two
+#define IEC_RX_QUEUE_MASK (IEC_RX_QUEUE_SIZE - 1u)
+
+/* listener side of a byte frame, advanced by ATN/CLK edges and the EOI timer */
+typedef enum
+{
+    IEC_Rx_State_Idle,      // not addressed, CLK edges are ignored
+    IEC_Rx_State_WaitReady, // holding DATA until the talker releases CLK
+    IEC_Rx_State_WaitStart, // DATA released, EOI timer running
+    IEC_Rx_State_EoiAck,    // DATA pulse acknowledging EOI
+    IEC_Rx_State_Bits,      // clocking in the byte
+    IEC_Rx_State_JiffyReady, // JiffyDOS, holding DATA until the talker pulls CLK
+    IEC_Rx_State_JiffyStart, // JiffyDOS, DATA released, the byte starts when CLK is released
+    IEC_Rx_State_JiffyBits,  // JiffyDOS, sampling two bits per step on the bus timer
+} IEC_Rx_State_t;
+
+/* bytes to send, filled by the main loop and emptied by the talker interrupts */
+#define IEC_TX_QUEUE_SIZE (32u) // power of two
+#define IEC_TX_QUEUE_MASK (IEC_TX_QUEUE_SIZE - 1u)
+#define IEC_TX_FLAG_EOI   (0x0100u)
+#define IEC_TX_FLAG_BLOCK (0x0200u) // last byte of a block from IEC_sendBlock()
+
+/* talker side of a byte frame, advanced by DATA edges and the bus timer */
+typedef enum
+{
+    IEC_Tx_State_Idle,         // not talking
+    IEC_Tx_State_Starved,      // talking, nothing queued
+    IEC_Tx_State_WaitListener, // CLK released, waiting for the listener to release DATA
+    IEC_Tx_State_WaitEoiAck,   // last byte, waiting for the listener to pull DATA
+    IEC_Tx_State_WaitEoiDone,  // waiting for the listener to release DATA again
+    IEC_Tx_State_Setup,        // CLK pulled, bit on DATA for IEC_S_TYP or adapted
+    IEC_Tx_State_Valid,        // CLK released for IEC_V_MIN_TALK
+    IEC_Tx_State_WaitAck,      // byte sent, waiting for the listener to pull DATA
+    IEC_Tx_State_Between,      // pause before the next byte
+    IEC_Tx_State_JiffyBits,    // JiffyDOS, two bits per step on the bus timer
+} IEC_Tx_State_t;
+
+/* adaptive timing, the frame ack of the first bytes of a talk shows how fast */
+/* the host polls the bus, bit setup is shrunk to that plus a margin; valid */
+/* stays at IEC_V_MIN_TALK and between at IEC_BB_MIN, they are minima already */
+#define IEC_ADAPT_SAMPLES      (16u) // bytes measured before the timing is changed
+#define IEC_ADAPT_MARGIN       (10u) // us on top of the slowest ack
+#define IEC_ADAPT_MAX_FAILURES (2u)  // framing errors before the host is left on typical timing
+
+/* with drive code on the bus the timer runs free over its whole range */
+#define IEC_DIRECT_CLOCK_LOAD (0xffffffffuL)
+
+/* JiffyDOS moves two bits per step, one on CLK and one on DATA, at fixed */
+/* times from the start of the byte; the last step carries the status. */
+/* Experimental: the step times are taken from published descriptions of */
+/* the protocol and have not been measured against a JiffyDOS host yet */
+#define IEC_JIFFY_NUM_STEPS (5u)
+#define IEC_JIFFY_STATUS    (0xffu)
+
+typedef struct
+{
+    uint8_t us;      // time from the previous step
+    uint8_t clkBit;  // bit on CLK, or IEC_JIFFY_STATUS
+    uint8_t dataBit; // bit on DATA
+} IEC_JiffyStep_t;
+
+/* listener, from the talker releasing CLK */
+static const IEC_JiffyStep_t jiffyRxSteps[IEC_JIFFY_NUM_STEPS] = {
+    { 14, 4, 5 },
+    { 13, 6, 7 },
+    { 11, 3, 1 },
+    { 11, 2, 0 },
+    { 11, IEC_JIFFY_STATUS, IEC_JIFFY_STATUS },
+};
+
+/* talker, from the listener releasing DATA */
+static const IEC_JiffyStep_t jiffyTxSteps[IEC_JIFFY_NUM_STEPS] = {
+    {  0, 0, 1 },
+    { 10, 2, 3 },
+    { 11, 4, 5 },
+    { 10, 6, 7 },
+    { 11, IEC_JIFFY_STATUS, IEC_JIFFY_STATUS },
+};
+
+/* talker side of the cartridge loaders, on the same steps as JiffyDOS; */
+/* experimental like those, the times are conservative until measured */
+/* against each cartridge */
+static const IEC_JiffyStep_t loaderTxSteps[IEC_Loader_Count][IEC_JIFFY_NUM_STEPS] = {
+    [IEC_Loader_EpyxFastLoad] = {
+        {  0, 0, 1 },
+        { 14, 2, 3 },
+        { 14, 4, 5 },
+        { 14, 6, 7 },
+        { 14, IEC_JIFFY_STATUS, IEC_JIFFY_STATUS },
+    },
+    [IEC_Loader_ActionReplay] = {
+        {  0, 0, 1 },
+        { 12, 2, 3 },
+        { 12, 4, 5 },
+        { 12, 6, 7 },
+        { 12, IEC_JIFFY_STATUS, IEC_JIFFY_STATUS },
+    },
+    [IEC_Loader_FinalCartridge3] = {
+        {  0, 0, 1 },
+        { 12, 2, 3 },
+        { 12, 4, 5 },
+        { 12, 6, 7 },
+        { 12, IEC_JIFFY_STATUS, IEC_JIFFY_STATUS },
+    },
+};
 
 static struct
 {
     IEC_USB_State_t USB;
     IEC_Disc_State_t disc;
-    bool EOIf;
-    FIFO_t fifo;
-    uint8_t byte;
-    bool fifoFull;
-} iec;
 
+    struct
+    {
+        volatile uint16_t queue[IEC_RX_QUEUE_SIZE];
+        volatile uint8_t head; // only written by the interrupts
+        volatile uint8_t tail; // only written by the consumer
+        uint8_t highWater;           // most entries waiting at once
+        volatile uint16_t overflows; // entries dropped on a full queue
+        IEC_Rx_State_t state;
+        uint8_t byte;
+        uint8_t nBits;
+        bool isAtn;
+        bool isEoi;
+        bool isListener;
+        bool isTalker;
+    } rx;
+
+    struct
+    {
+        volatile uint16_t queue[IEC_TX_QUEUE_SIZE];
+        volatile uint8_t head; // only written by the producer
+        volatile uint8_t tail; // only written by the interrupts
+        volatile IEC_Tx_State_t state;
+        volatile bool isAborted; // ATN or no listener, cleared when the next talk starts
+        volatile bool isEnded;   // IEC_endTalk(), cleared when the next TALK comes
+        uint16_t entry;
+        uint8_t nBits;
+
+        /* two-bit transfer picked at the turnaround, JiffyDOS or a loader */
+        const IEC_JiffyStep_t* steps;
+        const uint32_t* stepTicks;
+        bool isFast;
+        bool isBurst; // bytes of a block go out back to back
+
+        /* block streamed straight from the caller's buffer, after the queue */
+        const uint8_t* block;
+        volatile size_t blockRemaining;
+        bool blockEoi;
+        volatile IEC_Result_t blockResult;
+
+        uint32_t setupTicks; // IEC_S_TYP, or adapted to the host
+    } tx;
+
+    /* talker timing learned from the host, kept over talks until a framing error */
+    struct
+    {
+        bool isEnabled;
+        bool isTuned;
+        uint8_t nSamples;
+        uint8_t nFailures;
+        uint32_t maxAck; // slowest frame ack seen, bus timer ticks
+    } adapt;
+
+    /* JiffyDOS, asked for in every LISTEN/TALK by a host that has it */
+    struct
+    {
+        bool isDetected;   // host held back the last bit of this command byte
+        bool isDetecting;  // timing the held back last bit, the frame deadline is paused
+        bool isAnnouncing; // holding DATA to answer
+        bool isActive;     // data bytes of this LISTEN/TALK use JiffyDOS
+        bool isLoad;       // TALK on the LOAD channel, bytes of a block go out back to back
+    } jiffy;
+
+    IEC_Loader_t loader; // set when uploaded drive code was recognized
+    volatile bool isDirect; // drive code has the lines, the edges are not looked at
+    volatile bool isTimedOut; // a bus phase ran out of time, until picked up by IEC_getTimeout()
+    bool isDeadline; // the bus timer is running a deadline, not a protocol time
+
+    /* bus timer load values, converted once */
+    struct
+    {
+        uint32_t eoi;        // IEC_YE_MIN
+        uint32_t eoiHold;    // IEC_EI_MIN
+        uint32_t turnaround; // IEC_DA_MIN
+        uint32_t setup;      // IEC_S_TYP
+        uint32_t setupMin;   // IEC_S_MIN
+        uint32_t valid;      // IEC_V_MIN_TALK
+        uint32_t margin;     // IEC_ADAPT_MARGIN
+        uint32_t frame;      // IEC_F_MAX
+        uint32_t between;    // IEC_BB_MIN
+        uint32_t starved;    // IEC_TS_MAX
+        uint32_t jiffyDetect;   // IEC_JD_MIN
+        uint32_t jiffyAnnounce; // IEC_JA_TYP
+        uint32_t jiffyBetween;  // IEC_JB_MIN
+        uint32_t jiffyRx[IEC_JIFFY_NUM_STEPS];
+        uint32_t jiffyTx[IEC_JIFFY_NUM_STEPS];
+        uint32_t loaderTx[IEC_Loader_Count][IEC_JIFFY_NUM_STEPS];
+    } ticks;
+} iec;
 
-static void IEC_setDAT(const IEC_Output_t value);
-static void IEC_setCLK(const IEC_Output_t value);
 #ifdef USE_IEC_ATN_MACRO
 static void IEC_setATN(const IEC_Output_t value);
 #endif
 
-static IEC_Input_t IEC_readDAT(void);
-static IEC_Input_t IEC_readCLK(void);
-#ifdef USE_IEC_ATN_MACRO
-static IEC_Input_t IEC_readATN(void);
+static void IEC_onEdge(const uint8_t pin);
+static void IEC_onAtn(void);
+static void IEC_onClk(void);
+static void IEC_onData(void);
+static void IEC_onTimer(void);
+static void IEC_onRxTimer(void);
+static void IEC_onTxTimer(void);
+static void IEC_completeByte(void);
+static void IEC_pushRx(const uint16_t entry);
+static void IEC_startByte(void);
+static void IEC_putBit(void);
+static void IEC_stopTalking(const IEC_Result_t result);
+static void IEC_onTimeout(void);
+static void IEC_sampleAck(const uint32_t ticks);
+static void IEC_dropAdapted(void);
+static void IEC_onJiffyDetect(void);
+static void IEC_getJiffyStep(void);
+static void IEC_putJiffyStep(void);
+static void IEC_armEdge(const uint32_t pin, const IEC_Input_t level);
+static uint32_t IEC_getTicks(const uint32_t us);
+static uint32_t IEC_getTimerCount(void);
+static void IEC_startTimer(const uint32_t ticks);
+static void IEC_startDeadline(const uint32_t ticks);
+static void IEC_stopTimer(void);
+
+#ifndef WIN32
+/** @brief Paces both sides of the bus, the ms tick is on channel 0. */
+static const PeriodicTimer_t busTimer = {
+    .callback = IEC_onTimer,
+    .channel = 1,
+};
 #endif
 
 void IEC_init(void)
 {
-    iec.EOIf = false;
     iec.USB = USB_STATE_IDLE;
-    iec.byte = 0;
-    iec.fifoFull = false;
 
-    (void) FIFO_init(&iec.fifo, fifoBuffer, D64_FIELD_SIZE_NAME);
+    iec.rx.head = 0;
+    iec.rx.tail = 0;
+    iec.rx.highWater = 0;
+    iec.rx.overflows = 0;
+    iec.rx.state = IEC_Rx_State_Idle;
+    iec.rx.isAtn = false;
+    iec.rx.isEoi = false;
+    iec.rx.isListener = false;
+    iec.rx.isTalker = false;
+
+    iec.tx.head = 0;
+    iec.tx.tail = 0;
+    iec.tx.state = IEC_Tx_State_Idle;
+    iec.tx.isAborted = false;
+    iec.tx.isEnded = false;
+    iec.tx.blockRemaining = 0;
+    iec.tx.blockResult = IEC_Result_Ok;
+
+    iec.ticks.eoi = IEC_getTicks(IEC_YE_MIN);
+    iec.ticks.eoiHold = IEC_getTicks(IEC_EI_MIN);
+    iec.ticks.turnaround = IEC_getTicks(IEC_DA_MIN);
+    iec.ticks.setup = IEC_getTicks(IEC_S_TYP);
+    iec.ticks.setupMin = IEC_getTicks(IEC_S_MIN);
+    iec.ticks.valid = IEC_getTicks(IEC_V_MIN_TALK);
+    iec.ticks.margin = IEC_getTicks(IEC_ADAPT_MARGIN);
+    iec.ticks.frame = IEC_getTicks(IEC_F_MAX);
+    iec.ticks.between = IEC_getTicks(IEC_BB_MIN);
+    iec.ticks.starved = IEC_getTicks(IEC_TS_MAX);
+    iec.ticks.jiffyDetect = IEC_getTicks(IEC_JD_MIN);
+    iec.ticks.jiffyAnnounce = IEC_getTicks(IEC_JA_TYP);
+    iec.ticks.jiffyBetween = IEC_getTicks(IEC_JB_MIN);
+
+    for (uint8_t i = 0; i < IEC_JIFFY_NUM_STEPS; i++)
+    {
+        iec.ticks.jiffyRx[i] = IEC_getTicks(jiffyRxSteps[i].us);
+        iec.ticks.jiffyTx[i] = IEC_getTicks(jiffyTxSteps[i].us);
+
+        for (uint8_t k = 0; k < IEC_Loader_Count; k++)
+        {
+            iec.ticks.loaderTx[k][i] = IEC_getTicks(loaderTxSteps[k][i].us);
+        }
+    }
+
+    iec.loader = IEC_Loader_None;
+    iec.isDirect = false;
+    iec.isTimedOut = false;
+    iec.isDeadline = false;
+    iec.tx.steps = jiffyTxSteps;
+    iec.tx.stepTicks = iec.ticks.jiffyTx;
+    iec.tx.isFast = false;
+    iec.tx.isBurst = false;
+
+    iec.jiffy.isDetected = false;
+    iec.jiffy.isDetecting = false;
+    iec.jiffy.isAnnouncing = false;
+    iec.jiffy.isActive = false;
+    iec.jiffy.isLoad = false;
+
+    IEC_setAdaptive(true);
+
+#ifndef WIN32
+    const GPIOPinConfig_t input = { .pinDirection = GPIOPinDirection_Input, .outputLogic = 0 };
+    const GPIOPinConfig_t output = { .pinDirection = GPIOPinDirection_Output, .outputLogic = 0 };
+
+    GPIO_init(BOARD_IEC_GPIO, BOARD_IEC_ATN_IN_PIN, &input);
+    GPIO_init(BOARD_IEC_GPIO, BOARD_IEC_CLK_IN_PIN, &input);
+    GPIO_init(BOARD_IEC_GPIO, BOARD_IEC_DATA_IN_PIN, &input);
+    GPIO_init(BOARD_IEC_GPIO, BOARD_IEC_CLK_OUT_PIN, &output);
+    GPIO_init(BOARD_IEC_GPIO, BOARD_IEC_DATA_OUT_PIN, &output);
+
+    /* registers the callback, the timer is only started for a bus phase */
+    PeriodicTimer_enableGlobal();
+    PeriodicTimer_enableInterrupt(&busTimer, IEC_F_MAX);
+    PeriodicTimer_disable(&busTimer);
+
+    KBIPin_t atn = { .base = BOARD_IEC_KBI, .pin = BOARD_IEC_ATN_IN_PIN, .edge = KBIEdgeFalling };
+    KBIPin_t clk = { .base = BOARD_IEC_KBI, .pin = BOARD_IEC_CLK_IN_PIN, .edge = KBIEdgeRising };
+    KBIPin_t dat = { .base = BOARD_IEC_KBI, .pin = BOARD_IEC_DATA_IN_PIN, .edge = KBIEdgeRising };
+
+    (void) KBI_init(BOARD_IEC_KBI, KBIModeEdgeOnly, IEC_onEdge);
+    KBI_enablePin(&atn);
+    KBI_enablePin(&clk);
+    KBI_enablePin(&dat);
+
+    /* same priority, neither handler may cut into the other's state update; */
+    /* the timer handlers take a few us, well within IEC_AT_MAX for ATN */
+    NVIC_SetPriority(BOARD_IEC_KBI_IRQ, 0);
+    NVIC_SetPriority(PIT_CH1_IRQn, 0);
+    KBI_enableNVIC(&atn);
+#endif
 }
 
-uint8_t IEC_comRX()
+bool IEC_getCommand(uint8_t* const command)
 {
-    /* Returns type, NULL, command or byte. */
-    if (IEC_COM_State_Rx != iec.disc.communication)
+    /* data bytes still in front of a command were not wanted by anyone, drop them */
+    for (uint8_t tail = iec.rx.tail; tail != iec.rx.head; tail = (tail + 1u) & IEC_RX_QUEUE_MASK)
     {
-        return DATA_NULL;
+        const uint16_t entry = iec.rx.queue[tail];
+
+        if (entry & IEC_RX_FLAG_ATN)
+        {
+            *command = (uint8_t) (entry & 0xff);
+            iec.rx.tail = (tail + 1u) & IEC_RX_QUEUE_MASK;
+            return (true);
+        }
     }
 
-    /* We have identified this as reception, */
-    /* ready to recieve data. */
-    IEC_setDAT(IEC_Output_True);
-    IEC_setCLK(IEC_Output_False);
+    return (false);
+}
 
-    iec.EOIf = false;
+bool IEC_getByte(uint8_t* const byte, bool* const isEOI)
+{
+    const uint8_t tail = iec.rx.tail;
 
-    /* We are listener, wait for clock to go false. */
-    while (IEC_Input_False != IEC_readCLK())
+    if (tail == iec.rx.head)
     {
-        /* Wait.. */
+        return (false);
     }
 
-    /* C64 has indicated ready to send (RTS). */
-    iec.fifoFull = false;
+    /* commands are left for IEC_getCommand(), they end the data */
+    const uint16_t entry = iec.rx.queue[tail];
+    if (entry & IEC_RX_FLAG_ATN)
+    {
+        return (false);
+    }
 
-    IEC_setDAT(IEC_Output_False);
+    *byte = (uint8_t) (entry & 0xff);
+    *isEOI = (0 != (entry & IEC_RX_FLAG_EOI));
+    iec.rx.tail = (tail + 1u) & IEC_RX_QUEUE_MASK;
 
-    /* Wait for C64 to accept, or do we get EOI after timeout? */
-    while (IEC_Input_True != IEC_readCLK())
-    {
-        Delay_us(1);
+    return (true);
+}
 
-        /* Request timed out, EOI. */
-        iec.EOIf = true;
-        IEC_setDAT(IEC_Output_True);
+void IEC_getRxStats(IEC_RxStats_t* const stats)
+{
+    IEC_enterCritical();
+    stats->highWater = iec.rx.highWater;
+    stats->overflows = iec.rx.overflows;
+    IEC_exitCritical();
+}
 
-        Delay_us(IEC_DA_MIN);
+bool IEC_putByte(const uint8_t byte, const bool isEOI)
+{
+    if (!IEC_isTalking())
+    {
+        return (false);
+    }
 
-        /* EOI Ack. */
-        IEC_setDAT(IEC_Output_False);
+    const uint8_t head = iec.tx.head;
+    const uint8_t next = (head + 1u) & IEC_TX_QUEUE_MASK;
 
-        /* Wait for transmission start from C64. */
-        while (IEC_Input_True != IEC_readCLK())
-        {
-            // Wait.
-        }
+    if (next == iec.tx.tail)
+    {
+        return (false);
     }
 
-    /* Start transmission. */
-    /* We want to recieve 8 bits. */
-    uint8_t nBits = 0;
-    while (nBits < 8)
+    iec.tx.queue[head] = byte | (isEOI ? IEC_TX_FLAG_EOI : 0u);
+    iec.tx.head = next;
+
+    /* the talker stops when it runs dry, wake it up */
+    IEC_enterCritical();
+    if (IEC_Tx_State_Starved == iec.tx.state)
     {
-        /* Wait for data ready. */
-        while (IEC_Input_False != IEC_readCLK())
-        {
-            // Wait ..
-        }
+        IEC_startByte();
+    }
+    IEC_exitCritical();
 
-        /* Data ready, grab bit to fifo. */
-        const uint8_t byte = (uint8_t) IEC_readDAT();
-        (void) FIFO_write(&iec.fifo, byte);
+    return (true);
+}
 
-        nBits++;
+IEC_Result_t IEC_sendBlock(const uint8_t* const buf, const size_t len, const bool eoiOnLast)
+{
+    if (!IEC_isTalking())
+    {
+        return (IEC_Result_Aborted);
+    }
 
-        /* wait for next new bit */
-        while (IEC_Input_True != IEC_readCLK())
-        {
-            // Wait..
-        }
+    if ((IEC_Result_Busy == iec.tx.blockResult) || (0 == len))
+    {
+        return (IEC_Result_Busy);
     }
 
-    /* Acknowledge byte. */
-    IEC_setDAT(IEC_Output_True);
+    /* the interrupts take the bytes from here, buf has to stay put until done */
+    IEC_enterCritical();
+    iec.tx.block = buf;
+    iec.tx.blockEoi = eoiOnLast;
+    iec.tx.blockRemaining = len;
+    iec.tx.blockResult = IEC_Result_Busy;
 
-    /* What do we do next? was it the last byte or so? */
-    if (iec.EOIf)
+    if (IEC_Tx_State_Starved == iec.tx.state)
     {
-        iec.disc.communication = IEC_COM_State_Idle;
+        IEC_startByte();
     }
+    IEC_exitCritical();
+
+    return (IEC_Result_Ok);
+}
 
-    return (DATA_BYTE);
+IEC_Result_t IEC_getBlockResult(void)
+{
+    return (iec.tx.blockResult);
 }
 
-uint8_t IEC_TRANSMISSION_TX(uint8_t IEC_SEND_BYTE, uint8_t EOI){
-    if (IEC_COM_State_Tx != iec.disc.communication)
+void IEC_endTalk(void)
+{
+    /* before the turnaround the talker lets go as soon as it has turned around */
+    IEC_enterCritical();
+    iec.tx.isEnded = true;
+    if (IEC_Tx_State_Starved == iec.tx.state)
     {
-        return DATA_NULL;
+        IEC_stopTalking(IEC_Result_Ok);
     }
+    IEC_exitCritical();
+}
 
-    /* kinda like the above, but reversed and some diff times */
-
-    // IEC_SEND_BYTE is the data to send, should be loaded before this is called
-    /* we are ready to transmit data */
+void IEC_setDirect(const bool isDirect)
+{
+    IEC_enterCritical();
+    IEC_stopTimer();
+    iec.rx.state = IEC_Rx_State_Idle;
+    iec.tx.state = IEC_Tx_State_Idle;
+    iec.rx.isListener = false;
+    iec.rx.isTalker = false;
+    iec.isDirect = isDirect;
+    iec.disc.communication = IEC_COM_State_Idle;
+
+    /* both ways the lines start out released */
+    IEC_setCLK(IEC_Output_False);
     IEC_setDAT(IEC_Output_False);
-    IEC_setCLK(IEC_Output_True);
 
-    /* we are talker, wait for dat to go true */
-    while (IEC_Input_True != IEC_readDAT())
+    if (isDirect)
+    {
+        /* the bus timer is free while the engine stands by, the drive code is paced on it */
+#ifndef WIN32
+        PeriodicTimer_start(&busTimer, IEC_DIRECT_CLOCK_LOAD);
+#endif
+    }
+    else
     {
+        /* the host may be calling already, its ATN edge went by unseen */
+        IEC_onAtn();
+    }
+    IEC_exitCritical();
+}
 
+void IEC_setLoader(const IEC_Loader_t loader)
+{
+    if (loader < IEC_Loader_Count)
+    {
+        iec.loader = loader;
     }
+}
+
+void IEC_setAdaptive(const bool isAdaptive)
+{
+    IEC_enterCritical();
+    iec.adapt.isEnabled = isAdaptive;
+    iec.adapt.nFailures = 0;
+    IEC_dropAdapted();
+    IEC_exitCritical();
+}
 
-    /* c64 has indicated available */
+uint32_t IEC_getDirectClock(void)
+{
+#ifndef WIN32
+    /* counts down from IEC_DIRECT_CLOCK_LOAD, the full range wraps cleanly */
+    return (IEC_DIRECT_CLOCK_LOAD - PeriodicTimer_getCount(&busTimer));
+#else
+    return (0);
+#endif
+}
 
-    /* start transmission */
-    IEC_setCLK(IEC_Output_False);
+uint32_t IEC_getClockTicks(const uint32_t us)
+{
+#ifndef WIN32
+    return (PeriodicTimer_getTicks(us) + 1u);
+#else
+    return (us);
+#endif
+}
+
+bool IEC_hasPending(void)
+{
+    return ((iec.rx.tail != iec.rx.head) || iec.isTimedOut);
+}
+
+bool IEC_getTimeout(void)
+{
+    if (!iec.isTimedOut)
+    {
+        return (false);
+    }
 
-    /* indicate ready to send */
+    iec.isTimedOut = false;
+    return (true);
+}
 
-    while (IEC_Input_False != IEC_readDAT())
+bool IEC_isTalking(void)
+{
+    return ((IEC_Tx_State_Idle != iec.tx.state) && (!iec.tx.isAborted));
+}
+
+static void IEC_onEdge(const uint8_t pin)
+{
+    /* called from KBI0_IRQHandler in pin order, ATN first, after the flag is cleared; */
+    /* every handler reads its line again, so an edge it already saw flags a harmless repeat */
+    if (iec.isDirect)
     {
+        return;
+    }
 
+    if (IEC_ATN_PIN == pin)
+    {
+        IEC_onAtn();
     }
+    else if (IEC_CLK_PIN == pin)
+    {
+        IEC_onClk();
+    }
+    else if (IEC_DATA_PIN == pin)
+    {
+        IEC_onData();
+    }
+}
 
-    /* ready for data */
+static void IEC_onAtn(void)
+{
+    const IEC_Input_t atn = IEC_readATN();
+    IEC_armEdge(IEC_ATN_PIN, atn);
+    IEC_stopTimer();
 
-    if (EOI)
+    if (IEC_Input_True == atn)
     {
-        /**************************************************************************/
-        /* Go EOI here, we need to wait for a while before taking clock line true */
-        /**************************************************************************/
-        Delay_us(IEC_YE_TYP);
+        /* whatever we were sending is cut off, in the middle of a byte it is a framing error */
+        if (IEC_Tx_State_Idle != iec.tx.state)
+        {
+            if ((IEC_Tx_State_Setup == iec.tx.state) || (IEC_Tx_State_Valid == iec.tx.state))
+            {
+                IEC_dropAdapted();
+            }
+            IEC_stopTalking(IEC_Result_Aborted);
+        }
+
+        /* every device answers ATN by pulling DATA, commands follow */
+        IEC_setDAT(IEC_Output_True);
+        IEC_setCLK(IEC_Output_False);
 
-        IEC_setCLK(IEC_Output_True);
+        iec.rx.isAtn = true;
+        iec.rx.isEoi = false;
+        iec.rx.state = IEC_Rx_State_WaitReady;
+        iec.disc.communication = IEC_COM_State_Rx;
+    }
+    else
+    {
+        iec.rx.isAtn = false;
 
-        while (IEC_Input_True != IEC_readDAT())
+        if (iec.rx.isListener)
         {
-            /* wait for EOI ack */
-            Delay_us(1000);
+            /* keep holding DATA, the talker goes on with data bytes */
+            iec.rx.state = iec.jiffy.isActive ? IEC_Rx_State_JiffyReady : IEC_Rx_State_WaitReady;
         }
+        else
+        {
+            iec.rx.state = IEC_Rx_State_Idle;
+            IEC_setDAT(IEC_Output_False);
+
+            if (iec.rx.isTalker)
+            {
+                /* turnaround, we hold CLK from here on and the computer holds DATA */
+                IEC_setCLK(IEC_Output_True);
+                iec.disc.communication = IEC_COM_State_Tx;
+
+                iec.tx.tail = iec.tx.head;
+                iec.tx.isAborted = false;
+                iec.tx.blockRemaining = 0;
+                iec.tx.blockResult = IEC_Result_Ok;
+
+                /* a recognized loader takes over from JiffyDOS, both send in bursts */
+                if (IEC_Loader_None != iec.loader)
+                {
+                    iec.tx.steps = loaderTxSteps[iec.loader];
+                    iec.tx.stepTicks = iec.ticks.loaderTx[iec.loader];
+                    iec.tx.isFast = true;
+                    iec.tx.isBurst = true;
+                }
+                else
+                {
+                    iec.tx.steps = jiffyTxSteps;
+                    iec.tx.stepTicks = iec.ticks.jiffyTx;
+                    iec.tx.isFast = iec.jiffy.isActive;
+                    iec.tx.isBurst = iec.jiffy.isLoad;
+                }
+
+                iec.tx.state = IEC_Tx_State_Between;
+                IEC_startTimer(iec.ticks.turnaround);
+            }
+            else
+            {
+                iec.disc.communication = IEC_COM_State_Idle;
+            }
+        }
+    }
+
+    /* CLK may have moved before ATN was served */
+    IEC_onClk();
+}
 
-        iec.disc.communication = IEC_COM_State_Idle;
+static void IEC_onClk(void)
+{
+    const IEC_Input_t clk = IEC_readCLK();
+    IEC_armEdge(IEC_CLK_PIN, clk);
 
-        Delay_us(IEC_EI_MIN_TALK);
+    switch (iec.rx.state)
+    {
+        case IEC_Rx_State_WaitReady:
+            if (IEC_Input_False == clk)
+            {
+                /* talker is ready to send, we are ready for data */
+                IEC_setDAT(IEC_Output_False);
+                iec.rx.state = IEC_Rx_State_WaitStart;
+                IEC_startTimer(iec.ticks.eoi);
+            }
+            break;
+
+        case IEC_Rx_State_WaitStart:
+            if (IEC_Input_True == clk)
+            {
+                /* talker started the frame, every bit edge has IEC_F_MAX from here */
+                IEC_startDeadline(iec.ticks.frame);
+                iec.rx.byte = 0;
+                iec.rx.nBits = 0;
+                iec.rx.state = IEC_Rx_State_Bits;
+
+                if (iec.rx.isAtn)
+                {
+                    iec.jiffy.isDetected = false;
+                }
+            }
+            break;
+
+        case IEC_Rx_State_Bits:
+            if (IEC_Input_False == clk)
+            {
+                /* the host went on with the last bit, stop waiting or answering */
+                if (iec.rx.isAtn && (7 == iec.rx.nBits))
+                {
+                    IEC_stopTimer();
+                    iec.jiffy.isDetecting = false;
+                    if (iec.jiffy.isAnnouncing)
+                    {
+                        IEC_setDAT(IEC_Output_False);
+                        iec.jiffy.isAnnouncing = false;
+                    }
+                }
+
+                /* data is valid while CLK is released, released line is a one */
+                if (iec.rx.nBits < 8)
+                {
+                    iec.rx.byte |= (uint8_t) (((uint8_t) IEC_readDAT()) << iec.rx.nBits);
+                    iec.rx.nBits++;
+                }
+                IEC_startDeadline(iec.ticks.frame);
+            }
+            else if (8 == iec.rx.nBits)
+            {
+                /* talker holds CLK after the last bit, acknowledge the frame */
+                IEC_stopTimer();
+                IEC_setDAT(IEC_Output_True);
+                IEC_completeByte();
+                iec.rx.state = IEC_Rx_State_WaitReady;
+            }
+            else if (iec.rx.isAtn && (7 == iec.rx.nBits))
+            {
+                /* a JiffyDOS host holds back the last bit of a command, the */
+                /* window and the answer end in the frame deadline again */
+                iec.jiffy.isDetecting = true;
+                IEC_startTimer(iec.ticks.jiffyDetect);
+            }
+            else
+            {
+                IEC_startDeadline(iec.ticks.frame);
+            }
+            break;
+
+        case IEC_Rx_State_JiffyReady:
+            if (IEC_Input_True == clk)
+            {
+                IEC_setDAT(IEC_Output_False);
+                iec.rx.state = IEC_Rx_State_JiffyStart;
+            }
+            break;
+
+        case IEC_Rx_State_JiffyStart:
+            if (IEC_Input_False == clk)
+            {
+                /* from here the bits are sampled on time, not on edges */
+                iec.rx.byte = 0;
+                iec.rx.nBits = 0;
+                iec.rx.state = IEC_Rx_State_JiffyBits;
+                IEC_startTimer(iec.ticks.jiffyRx[0]);
+            }
+            break;
+
+        default:
+            break;
     }
+}
 
-    /* start transmission */
-    IEC_setCLK(IEC_Output_True);
+static void IEC_onData(void)
+{
+    const IEC_Input_t dat = IEC_readDAT();
+    IEC_armEdge(IEC_DATA_PIN, dat);
+
+    switch (iec.tx.state)
+    {
+        case IEC_Tx_State_WaitListener:
+            if (IEC_Input_False == dat)
+            {
+                if (iec.tx.isFast)
+                {
+                    /* JiffyDOS has no EOI handshake, it is in the status step */
+                    iec.tx.nBits = 0;
+                    IEC_putJiffyStep();
+                }
+                else if (iec.tx.entry & IEC_TX_FLAG_EOI)
+                {
+                    /* hold back CLK, the listener times out and acknowledges EOI */
+                    iec.tx.state = IEC_Tx_State_WaitEoiAck;
+                    IEC_startDeadline(iec.ticks.frame);
+                }
+                else
+                {
+                    IEC_putBit();
+                }
+            }
+            break;
+
+        case IEC_Tx_State_WaitEoiAck:
+            if (IEC_Input_True == dat)
+            {
+                iec.tx.state = IEC_Tx_State_WaitEoiDone;
+                IEC_startDeadline(iec.ticks.frame);
+            }
+            break;
+
+        case IEC_Tx_State_WaitEoiDone:
+            if (IEC_Input_False == dat)
+            {
+                IEC_stopTimer();
+                IEC_putBit();
+            }
+            break;
+
+        case IEC_Tx_State_WaitAck:
+            if (IEC_Input_True == dat)
+            {
+                /* frame accepted, the timer was loaded with IEC_F_MAX at the last bit */
+                if (!iec.tx.isFast)
+                {
+                    IEC_sampleAck(iec.ticks.frame - IEC_getTimerCount());
+                }
+                IEC_stopTimer();
+
+                if (iec.tx.entry & IEC_TX_FLAG_BLOCK)
+                {
+                    iec.tx.blockResult = IEC_Result_Ok;
+                }
+
+                if (iec.tx.entry & IEC_TX_FLAG_EOI)
+                {
+                    IEC_stopTalking(IEC_Result_Ok);
+                }
+                else
+                {
+                    iec.tx.state = IEC_Tx_State_Between;
+                    IEC_startTimer(iec.tx.isFast ? iec.ticks.jiffyBetween : iec.ticks.between);
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
 
-    Delay_us(60);
+static void IEC_onTimer(void)
+{
+    /* one timer for both sides, only one of them is busy at a time */
+    const bool isDeadline = iec.isDeadline;
+    IEC_stopTimer();
 
-    /* we want to send 8 bits */
-    uint8_t nBits = 0;
-    while (nBits < 8)
+    if (isDeadline)
     {
-        IEC_setCLK(IEC_Output_False);
-        IEC_setDAT(IEC_SEND_BYTE & 0x01); // NOTE: Negate if strange results..
-        IEC_SEND_BYTE = IEC_SEND_BYTE >> 1u;
+        IEC_onTimeout();
+    }
+    else if (IEC_Tx_State_Idle != iec.tx.state)
+    {
+        IEC_onTxTimer();
+    }
+    else
+    {
+        IEC_onRxTimer();
+    }
+}
+
+static void IEC_onTxTimer(void)
+{
+    switch (iec.tx.state)
+    {
+        case IEC_Tx_State_Setup:
+            /* bit is settled, let the listener read it */
+            IEC_setCLK(IEC_Output_False);
+            iec.tx.state = IEC_Tx_State_Valid;
+            IEC_startTimer(iec.ticks.valid);
+            break;
+
+        case IEC_Tx_State_Valid:
+            IEC_setCLK(IEC_Output_True);
+            iec.tx.nBits++;
+
+            if (iec.tx.nBits < 8)
+            {
+                iec.tx.state = IEC_Tx_State_Setup;
+                IEC_setDAT(((iec.tx.entry >> iec.tx.nBits) & 0x01) ? IEC_Output_False : IEC_Output_True);
+                IEC_startTimer(iec.tx.setupTicks);
+            }
+            else
+            {
+                /* all bits out, the listener has IEC_F_MAX to pull DATA */
+                IEC_setDAT(IEC_Output_False);
+                iec.tx.state = IEC_Tx_State_WaitAck;
+                IEC_startTimer(iec.ticks.frame);
+                IEC_onData();
+            }
+            break;
+
+        case IEC_Tx_State_WaitAck:
+            /* nobody took the byte, maybe it went by too fast */
+            IEC_dropAdapted();
+            IEC_onTimeout();
+            break;
+
+        case IEC_Tx_State_Between:
+            IEC_startByte();
+            break;
+
+        case IEC_Tx_State_JiffyBits:
+            IEC_putJiffyStep();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void IEC_startByte(void)
+{
+    if (iec.tx.tail != iec.tx.head)
+    {
+        iec.tx.entry = iec.tx.queue[iec.tx.tail];
+        iec.tx.tail = (iec.tx.tail + 1u) & IEC_TX_QUEUE_MASK;
+    }
+    else if (0 != iec.tx.blockRemaining)
+    {
+        iec.tx.entry = *iec.tx.block;
+        iec.tx.block++;
+        iec.tx.blockRemaining--;
+
+        if (0 == iec.tx.blockRemaining)
+        {
+            iec.tx.entry |= IEC_TX_FLAG_BLOCK | (iec.tx.blockEoi ? IEC_TX_FLAG_EOI : 0u);
+        }
+    }
+    else if (iec.tx.isEnded)
+    {
+        /* CLK let go without a frame, the host times out on an empty talk */
+        IEC_stopTalking(IEC_Result_Ok);
+        return;
+    }
+    else
+    {
+        /* keep CLK while the caller gets the next bytes, not forever */
+        iec.tx.state = IEC_Tx_State_Starved;
+        IEC_startDeadline(iec.ticks.starved);
+        return;
+    }
+
+    /* the starved deadline is over, the listener may take its time */
+    IEC_stopTimer();
+    iec.tx.nBits = 0;
 
-        Delay_us(IEC_S_TYP);
+    /* ready to send, wait for the listener to be ready for data */
+    iec.tx.state = IEC_Tx_State_WaitListener;
+    IEC_setCLK(IEC_Output_False);
+    IEC_onData();
+}
+
+static void IEC_putBit(void)
+{
+    /* start of frame, first bit goes out LSB first, a pulled line is a zero */
+    IEC_setCLK(IEC_Output_True);
+    IEC_setDAT((iec.tx.entry & 0x01) ? IEC_Output_False : IEC_Output_True);
+    iec.tx.state = IEC_Tx_State_Setup;
+    IEC_startTimer(iec.tx.setupTicks);
+}
+
+static void IEC_stopTalking(const IEC_Result_t result)
+{
+    IEC_stopTimer();
+    IEC_setCLK(IEC_Output_False);
+    IEC_setDAT(IEC_Output_False);
 
-        IEC_setCLK(IEC_Output_True);
+    /* a block cut short is reported once, with the reason */
+    if (IEC_Result_Busy == iec.tx.blockResult)
+    {
+        iec.tx.blockResult = result;
+    }
+    iec.tx.blockRemaining = 0;
 
-        Delay_us(IEC_V_MIN_TALK);
+    iec.tx.isAborted = (IEC_Result_Ok != result);
+    iec.tx.tail = iec.tx.head;
+    iec.tx.state = IEC_Tx_State_Idle;
+    iec.disc.communication = IEC_COM_State_Idle;
+}
 
-        nBits++;
+static void IEC_onTimeout(void)
+{
+    /* the host is gone or was reset, let go of the bus and forget the addressing */
+    if (IEC_Tx_State_Idle != iec.tx.state)
+    {
+        IEC_stopTalking(IEC_Result_Timeout);
     }
 
-    /* release DAT */
+    IEC_setCLK(IEC_Output_False);
     IEC_setDAT(IEC_Output_False);
 
-    /* check for ACK */
-    while (IEC_Input_True != IEC_readDAT())
+    iec.rx.state = IEC_Rx_State_Idle;
+    iec.rx.isAtn = false;
+    iec.rx.isEoi = false;
+    iec.rx.isListener = false;
+    iec.rx.isTalker = false;
+    iec.jiffy.isDetecting = false;
+    iec.jiffy.isAnnouncing = false;
+    iec.jiffy.isActive = false;
+    iec.loader = IEC_Loader_None;
+    iec.disc.communication = IEC_COM_State_Idle;
+
+    iec.isTimedOut = true;
+}
+
+static void IEC_sampleAck(const uint32_t ticks)
+{
+    if ((!iec.adapt.isEnabled) || iec.adapt.isTuned || (iec.adapt.nFailures >= IEC_ADAPT_MAX_FAILURES))
+    {
+        return;
+    }
+
+    if (ticks > iec.adapt.maxAck)
+    {
+        iec.adapt.maxAck = ticks;
+    }
+
+    iec.adapt.nSamples++;
+    if (iec.adapt.nSamples < IEC_ADAPT_SAMPLES)
+    {
+        return;
+    }
+
+    /* a host that acks within this polls at least that often and sees the */
+    /* bit settle in time; never below IEC_S_MIN or above typical */
+    const uint32_t target = iec.adapt.maxAck + iec.ticks.margin;
+
+    iec.tx.setupTicks = (target < iec.ticks.setupMin) ? iec.ticks.setupMin : (target > iec.ticks.setup) ? iec.ticks.setup : target;
+    iec.adapt.isTuned = true;
+}
+
+static void IEC_dropAdapted(void)
+{
+    if (iec.adapt.isTuned)
     {
-        Delay_us(IEC_PR_MIN_TALK);
+        iec.adapt.nFailures++;
+    }
+
+    /* back to typical, measured again unless the host failed too often */
+    iec.tx.setupTicks = iec.ticks.setup;
+    iec.adapt.isTuned = false;
+    iec.adapt.nSamples = 0;
+    iec.adapt.maxAck = 0;
+}
+
+static void IEC_onRxTimer(void)
+{
 
-        if (IEC_Input_True == IEC_readDAT())
+    if (IEC_Rx_State_Bits == iec.rx.state)
+    {
+        if (iec.jiffy.isDetecting)
         {
-            /* Abort. */
-            iec.disc.communication = IEC_COM_State_Idle;
-            return (0xff);
+            IEC_onJiffyDetect();
         }
+        else
+        {
+            /* nothing of ours is timed in the middle of a byte */
+            IEC_onTimeout();
+        }
+    }
+    else if (IEC_Rx_State_JiffyBits == iec.rx.state)
+    {
+        IEC_getJiffyStep();
+    }
+    else if (IEC_Rx_State_WaitStart == iec.rx.state)
+    {
+        /* talker did not start within IEC_YE_MIN, the next byte is the last */
+        iec.rx.isEoi = true;
+        IEC_setDAT(IEC_Output_True);
+        iec.rx.state = IEC_Rx_State_EoiAck;
+        IEC_startTimer(iec.ticks.eoiHold);
+    }
+    else if (IEC_Rx_State_EoiAck == iec.rx.state)
+    {
+        /* EOI acknowledged, the talker has IEC_F_MAX to start the last byte */
+        IEC_setDAT(IEC_Output_False);
+        iec.rx.state = IEC_Rx_State_WaitStart;
+        IEC_startDeadline(iec.ticks.frame);
+    }
+}
+
+static void IEC_onJiffyDetect(void)
+{
+    if (iec.jiffy.isAnnouncing)
+    {
+        IEC_setDAT(IEC_Output_False);
+        iec.jiffy.isAnnouncing = false;
+        iec.jiffy.isDetecting = false;
+        IEC_startDeadline(iec.ticks.frame);
     }
+    else if (DEVICE_ID == (iec.rx.byte & 0x1f))
+    {
+        /* the device number is in already, answer only if it is us */
+        IEC_setDAT(IEC_Output_True);
+        iec.jiffy.isAnnouncing = true;
+        iec.jiffy.isDetected = true;
+        IEC_startTimer(iec.ticks.jiffyAnnounce);
+    }
+    else
+    {
+        iec.jiffy.isDetecting = false;
+        IEC_startDeadline(iec.ticks.frame);
+    }
+}
+
+static void IEC_getJiffyStep(void)
+{
+    const IEC_JiffyStep_t* const step = &jiffyRxSteps[iec.rx.nBits];
 
-    Delay_us(IEC_BB_MIN);
+    if (IEC_JIFFY_STATUS == step->clkBit)
+    {
+        /* CLK released at the end of the byte means it was the last */
+        iec.rx.isEoi = (IEC_Input_False == IEC_readCLK());
+        IEC_setDAT(IEC_Output_True);
+        IEC_completeByte();
+        iec.rx.state = IEC_Rx_State_JiffyReady;
+        IEC_onClk();
+        return;
+    }
 
-    return (0x00);
+    /* released line is a one, as for the slow bits */
+    iec.rx.byte |= (uint8_t) (((uint8_t) IEC_readCLK()) << step->clkBit);
+    iec.rx.byte |= (uint8_t) (((uint8_t) IEC_readDAT()) << step->dataBit);
+    iec.rx.nBits++;
+    IEC_startTimer(iec.ticks.jiffyRx[iec.rx.nBits]);
 }
 
-static void IEC_setDAT(const IEC_Output_t value)
+static void IEC_putJiffyStep(void)
 {
+    const IEC_JiffyStep_t* const step = &iec.tx.steps[iec.tx.nBits];
 
+    if (IEC_JIFFY_STATUS == step->clkBit)
+    {
+        /* CLK tells the host if more is coming, it acknowledges on DATA */
+        IEC_setCLK((iec.tx.entry & IEC_TX_FLAG_EOI) ? IEC_Output_False : IEC_Output_True);
+        IEC_setDAT(IEC_Output_False);
+        iec.tx.state = IEC_Tx_State_WaitAck;
+        IEC_startTimer(iec.ticks.frame);
+        IEC_onData();
+        return;
+    }
+
+    IEC_setCLK(((iec.tx.entry >> step->clkBit) & 0x01) ? IEC_Output_False : IEC_Output_True);
+    IEC_setDAT(((iec.tx.entry >> step->dataBit) & 0x01) ? IEC_Output_False : IEC_Output_True);
+    iec.tx.nBits++;
+
+    /* a LOAD burst only stops for the status at the end of a block */
+    const bool isBurst = iec.tx.isBurst && (0 == (iec.tx.entry & (IEC_TX_FLAG_EOI | IEC_TX_FLAG_BLOCK)));
+
+    if (isBurst && (IEC_JIFFY_STATUS == iec.tx.steps[iec.tx.nBits].clkBit))
+    {
+        iec.tx.state = IEC_Tx_State_Between;
+    }
+    else
+    {
+        iec.tx.state = IEC_Tx_State_JiffyBits;
+    }
+    IEC_startTimer(iec.tx.stepTicks[iec.tx.nBits]);
 }
 
-static void IEC_setCLK(const IEC_Output_t value)
+static void IEC_completeByte(void)
 {
+    const uint8_t byte = iec.rx.byte;
+
+    if (iec.rx.isAtn)
+    {
+        /* keep track of addressing, only what concerns this device is queued */
+        if (IEC_Command_Unlisten == byte)
+        {
+            iec.rx.isListener = false;
+            iec.jiffy.isActive = false;
+        }
+        else if (IEC_Command_Untalk == byte)
+        {
+            iec.rx.isTalker = false;
+            iec.jiffy.isActive = false;
+            iec.loader = IEC_Loader_None; // the drive code is done once the host lets go
+        }
+        else if (IEC_Command_Listen == (byte & 0xe0))
+        {
+            if (DEVICE_ID != (byte & 0x1f))
+            {
+                return;
+            }
+            iec.rx.isListener = true;
+            iec.jiffy.isActive = iec.jiffy.isDetected;
+            iec.jiffy.isLoad = false;
+        }
+        else if (IEC_Command_Talk == (byte & 0xe0))
+        {
+            /* there is only one talker */
+            iec.rx.isTalker = (DEVICE_ID == (byte & 0x1f));
+            if (!iec.rx.isTalker)
+            {
+                return;
+            }
+            iec.tx.isEnded = false;
+            iec.jiffy.isActive = iec.jiffy.isDetected;
+            iec.jiffy.isLoad = false;
+        }
+        else if (iec.rx.isTalker && ((IEC_Command_OpenDat | 0x01) == byte))
+        {
+            /* JiffyDOS LOAD reads the program on secondary address 1 */
+            iec.jiffy.isLoad = iec.jiffy.isActive;
+        }
+        else if ((!iec.rx.isListener) && (!iec.rx.isTalker))
+        {
+            return; // secondary address for another device
+        }
+
+        IEC_pushRx(byte | IEC_RX_FLAG_ATN);
+    }
+    else if (iec.rx.isListener)
+    {
+        IEC_pushRx(byte | (iec.rx.isEoi ? IEC_RX_FLAG_EOI : 0u));
+    }
 
+    iec.rx.isEoi = false;
 }
 
-#ifdef USE_IEC_ATN_MACRO
-static void IEC_setATN(const IEC_Output_t value)
+static void IEC_pushRx(const uint16_t entry)
 {
+    const uint8_t head = iec.rx.head;
+    const uint8_t next = (head + 1u) & IEC_RX_QUEUE_MASK;
+
+    const uint8_t used = (head - iec.rx.tail) & IEC_RX_QUEUE_MASK;
+
+    if (next == iec.rx.tail)
+    {
+        iec.rx.overflows++;
+        return;
+    }
 
+    iec.rx.queue[head] = entry;
+    iec.rx.head = next;
+
+    if (used >= iec.rx.highWater)
+    {
+        iec.rx.highWater = used + 1u;
+    }
 }
+
+static void IEC_armEdge(const uint32_t pin, const IEC_Input_t level)
+{
+    /* edge only mode, wait for the line to go the other way */
+#ifndef WIN32
+    if (IEC_Input_True == level)
+    {
+        BOARD_IEC_KBI->ES |= (1u << pin); // line is pulled, next is the rising edge
+    }
+    else
+    {
+        BOARD_IEC_KBI->ES &= ~(1u << pin);
+    }
 #endif
+}
 
-static IEC_Input_t IEC_readDAT(void)
+static uint32_t IEC_getTicks(const uint32_t us)
 {
 #ifndef WIN32
-    const IEC_Input_t result = (GPIO_PinRead(kGPIO_PORTA, 0)) ? IEC_Input_False : IEC_Input_True;
+    return (PeriodicTimer_getTicks(us));
 #else
-    const IEC_Input_t result = IEC_Input_False;
+    return (us);
 #endif
-    return (result);
 }
 
-static IEC_Input_t IEC_readCLK(void)
+static uint32_t IEC_getTimerCount(void)
 {
 #ifndef WIN32
-    const IEC_Input_t result = (GPIO_PinRead(kGPIO_PORTA, 0)) ? IEC_Input_False : IEC_Input_True;
+    return (PeriodicTimer_getCount(&busTimer));
 #else
-    const IEC_Input_t result = IEC_Input_False;
+    return (0);
 #endif
-    return (result);
 }
 
-#ifdef USE_IEC_ATN_MACRO
-static IEC_Input_t IEC_readATN(void)
+static void IEC_startTimer(const uint32_t ticks)
 {
+    iec.isDeadline = false;
 #ifndef WIN32
-    const IEC_Input_t result = (GPIO_PinRead(kGPIO_PORTA, 0)) ? IEC_Input_False : IEC_Input_True;
-#else
-    const IEC_Input_t result = IEC_Input_False;
+    PeriodicTimer_restart(&busTimer, ticks);
+#endif
+}
+
+static void IEC_startDeadline(const uint32_t ticks)
+{
+    /* nothing happens on time here, expiry means the other side is gone */
+    IEC_startTimer(ticks);
+    iec.isDeadline = true;
+}
+
+static void IEC_stopTimer(void)
+{
+    iec.isDeadline = false;
+#ifndef WIN32
+    PeriodicTimer_disable(&busTimer);
+    PeriodicTimer_clearFlag(&busTimer);
 #endif
-    return (result);
+}
+
+#ifdef USE_IEC_ATN_MACRO
+static void IEC_setATN(const IEC_Output_t value)
+{
+
 }
 #endif
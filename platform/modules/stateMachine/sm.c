@@ -6,6 +6,22 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define SM_PAYLOAD_NONE (0xffu)
+
+/* Payload pool, the free slots are chained through next so that taking and */
+/* giving back a slot is O(1). */
+static struct
+{
+    uint8_t slot[SM_PAYLOAD_NUM_SLOTS][SM_PAYLOAD_SLOT_SIZE];
+    uint8_t next[SM_PAYLOAD_NUM_SLOTS];
+    uint8_t freeHead;
+    bool isInitialised;
+    SM_PoolStats_t stats;
+} pool;
+
+static void* SM_allocPayload(const size_t size);
+static void SM_releasePayload(void* const data);
+
 void SM_initState(SM_State_t* const state, const int32_t id, const SM_Enact_t enact, const SM_OnCycle_t oncycle, const SM_Exact_t exact)
 {
     state->id = id;
@@ -117,12 +133,20 @@ void SM_raiseEv(SM_Event_t* const ev, const void* const data, const size_t s)
 	{
 		ev->raised = true;
 
+		// A payload raised again replaces the one not yet consumed.
+		if (ev->data)
+		{
+		    SM_releasePayload(ev->data);
+		    ev->data = (void*) 0;
+		    ev->size = 0;
+		}
+
 		if ((data) && (s))
 		{
-		    ev->size = s;
-		    ev->data = malloc(s);
+		    ev->data = SM_allocPayload(s);
 		    if (ev->data)
 		    {
+		        ev->size = s;
 		        memcpy(ev->data, data, s);
 		    }
 		}
@@ -136,7 +160,8 @@ void SM_clearEv(SM_Event_t* const ev)
 		ev->raised = false;
 		if (ev->data)
 		{
-		    free(ev->data);
+		    SM_releasePayload(ev->data);
+		    ev->data = (void*) 0;
 		    ev->size = 0;
 		}
 	}
@@ -183,3 +208,46 @@ bool SM_evCmp(const SM_Event_t* const ev, const int32_t id)
     return (result);
 }
 
+void SM_getPoolStats(SM_PoolStats_t* const stats)
+{
+    *stats = pool.stats;
+}
+
+static void* SM_allocPayload(const size_t size)
+{
+    if (!pool.isInitialised)
+    {
+        for (uint8_t i = 0; i < SM_PAYLOAD_NUM_SLOTS; i++)
+        {
+            pool.next[i] = ((i + 1u) < SM_PAYLOAD_NUM_SLOTS) ? (i + 1u) : SM_PAYLOAD_NONE;
+        }
+        pool.freeHead = 0;
+        pool.isInitialised = true;
+    }
+
+    if ((size > SM_PAYLOAD_SLOT_SIZE) || (SM_PAYLOAD_NONE == pool.freeHead))
+    {
+        pool.stats.failures++;
+        return ((void*) 0);
+    }
+
+    const uint8_t index = pool.freeHead;
+    pool.freeHead = pool.next[index];
+
+    pool.stats.inUse++;
+    if (pool.stats.inUse > pool.stats.highWater)
+    {
+        pool.stats.highWater = pool.stats.inUse;
+    }
+
+    return (pool.slot[index]);
+}
+
+static void SM_releasePayload(void* const data)
+{
+    const uint8_t index = (uint8_t) (((uint8_t*) data - &pool.slot[0][0]) / SM_PAYLOAD_SLOT_SIZE);
+
+    pool.next[index] = pool.freeHead;
+    pool.freeHead = index;
+    pool.stats.inUse--;
+}
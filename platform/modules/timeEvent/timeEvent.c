@@ -12,27 +12,35 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifndef WIN32
 #include "kexx_timer.h"
+#endif
 
 #define TIMEEVENT_TICKTIME_MS (1)
 
+#ifndef WIN32
 static void TimeEvent_updateClockTime(void);
+#endif
 
 
 
 static uint32_t clockTime_ms = 0;
 
+#ifndef WIN32
 /** @brief Periodic timer setup struct. */
 static const PeriodicTimer_t timerTickSource = {
     .callback = TimeEvent_updateClockTime,
     .channel = 0,
 };
+#endif
 
 void TimeEvent_init(void)
 {
-    /* Start the timer */
+    /* Start the timer, the host build has no tick and time stands still */
+#ifndef WIN32
     PeriodicTimer_enableGlobal();
     PeriodicTimer_enableInterrupt(&timerTickSource, TIMEEVENT_TICKTIME_MS * 1000u);
+#endif
 }
 
 uint32_t TimeEvent_getClockTime(void)
@@ -63,7 +71,9 @@ uint32_t TimeEvent_getElapsedTime_ms(TimeEvent_t* const ev)
     return (ev->timeNow_ms - ev->timeSet_ms);
 }
 
+#ifndef WIN32
 static void TimeEvent_updateClockTime(void)
 {
     clockTime_ms += TIMEEVENT_TICKTIME_MS;
 }
+#endif